@@ -0,0 +1,87 @@
+#!/usr/bin/env node
+/*
+ * Check the built WebAssembly cores against the JavaScript engine
+ *
+ * Serves web/ locally, opens bench.html?check in headless Chromium and
+ * waits for its verdict: every benchmark case searched on both engines
+ * must give the same results (see checkAll() in web/bench.html). It runs
+ * twice: plainly, where the single-threaded core loads, and with the
+ * COOP/COEP headers sw.js adds, where the page is cross-origin isolated
+ * and must load resistorcal-core-mt with more than one thread. Both
+ * matching the JS engine, the two cores match each other.
+ * Requires: web/resistorcal-core{,-mt}.{js,wasm} (emcmake cmake), playwright
+ */
+
+import { createServer } from 'node:http';
+import { readFile } from 'node:fs/promises';
+import { extname, join, normalize } from 'node:path';
+import { fileURLToPath } from 'node:url';
+import { chromium } from 'playwright';
+
+const WEB_DIR = fileURLToPath(new URL('../web/', import.meta.url));
+const TIMEOUT = 120000;
+
+const TYPES = {
+  '.html': 'text/html',
+  '.js': 'text/javascript',
+  '.wasm': 'application/wasm',
+  '.json': 'application/json',
+  '.svg': 'image/svg+xml',
+  '.png': 'image/png'
+};
+
+// Static server for web/; isolated adds the headers of isolate() in sw.js
+function serve(isolated) {
+  const server = createServer(async (req, res) => {
+    const path = normalize(decodeURIComponent(new URL(req.url, 'http://localhost').pathname));
+    try {
+      const body = await readFile(join(WEB_DIR, path.endsWith('/') ? 'index.html' : path));
+      const headers = { 'Content-Type': TYPES[extname(path)] || 'application/octet-stream' };
+      if (isolated) {
+        headers['Cross-Origin-Opener-Policy'] = 'same-origin';
+        headers['Cross-Origin-Embedder-Policy'] = 'require-corp';
+      }
+      res.writeHead(200, headers);
+      res.end(body);
+    } catch (e) {
+      res.writeHead(404);
+      res.end();
+    }
+  });
+  return new Promise(resolve => server.listen(0, '127.0.0.1', () => resolve(server)));
+}
+
+// Run the page check; resolves to true when it passes
+async function check(browser, name, isolated) {
+  const server = await serve(isolated);
+  const page = await browser.newPage();
+  try {
+    await page.goto(`http://127.0.0.1:${server.address().port}/bench.html?check`);
+    await page.waitForSelector('body[data-check]', { timeout: TIMEOUT });
+    const { verdict, threads, shared } = await page.evaluate(() => ({
+      verdict: document.body.dataset.check,
+      threads: Number(document.body.dataset.threads),
+      shared: self.crossOriginIsolated
+    }));
+    console.log(`${name}:\n${await page.textContent('#check')}`);
+    if (isolated && !(shared && threads > 1)) {
+      console.log(`FAIL: threaded core not in use (isolated: ${shared}, threads: ${threads})`);
+      return false;
+    }
+    return verdict === 'ok';
+  } finally {
+    await page.close();
+    server.close();
+  }
+}
+
+const browser = await chromium.launch();
+let ok;
+try {
+  ok = await check(browser, 'single-threaded core', false);
+  ok = await check(browser, 'multi-threaded core (COOP/COEP)', true) && ok;
+} finally {
+  await browser.close();
+}
+console.log(ok ? 'web core check: ok' : 'web core check: FAIL');
+process.exit(ok ? 0 : 1);
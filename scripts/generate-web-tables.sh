@@ -0,0 +1,24 @@
+#!/bin/bash
+#
+# Generate the precomputed network tables shipped with the PWA
+# Requires: a C compiler (cc)
+#
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+TABLES_DIR="$PROJECT_DIR/web/tables"
+TOOL="$(mktemp)"
+
+trap 'rm -f "$TOOL"' EXIT
+
+mkdir -p "$TABLES_DIR"
+
+echo "Generating web network tables..."
+
+cc -std=c99 -O2 -D_POSIX_C_SOURCE=200809L -I"$PROJECT_DIR/src" \
+    "$SCRIPT_DIR/web-tables.c" "$PROJECT_DIR/src/network.c" "$PROJECT_DIR/src/parallel.c" \
+    -o "$TOOL" -lm -lpthread
+"$TOOL" "$TABLES_DIR"
+
+echo "Done!"
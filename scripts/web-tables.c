@@ -0,0 +1,176 @@
+/*
+ * web-tables.c - Precomputed network tables for the PWA
+ *
+ * Builds every network of the standard chip selection with the desktop
+ * engine and writes it sorted by R, so the web app answers a query with
+ * a binary search instead of an enumeration. Run through
+ * scripts/generate-web-tables.sh.
+ *
+ * File layout (little-endian):
+ *   char     magic[4]        "RNT1"
+ *   uint32   num_values
+ *   uint32   num_networks
+ *   uint32   stride          program bytes per network (2 * MAX_N - 1)
+ *   float64  values[num_values]       selection, ascending
+ *   float64  R[num_networks]          ascending
+ *   uint8    n[num_networks]          parts
+ *   uint8    program[num_networks][stride]
+ *            postfix: value index, 254 = series, 255 = parallel
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "network.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STRIDE (2 * MAX_N - 1)
+#define OP_SERIES 254
+#define OP_PARALLEL 255
+
+/*
+ * RESISTORS in web/index.html, ascending: calculate() sorts every
+ * selection before searching, so the All, E12 and E24 buttons (and any
+ * toggling back to the full set) find this table.
+ */
+static const double STANDARD[] = {
+    1, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2,
+    10, 12, 15, 18, 22, 27, 33, 39, 47, 56, 68, 82,
+    100, 120, 150, 180, 220, 270, 330, 390, 470, 560, 680, 820,
+    1e3, 1.2e3, 1.5e3, 1.8e3, 2.2e3, 2.7e3, 3.3e3, 3.9e3, 4.7e3, 5.6e3, 6.8e3, 8.2e3,
+    10e3, 12e3, 15e3, 18e3, 22e3, 27e3, 33e3, 39e3, 47e3, 56e3, 68e3, 82e3,
+    100e3, 120e3, 150e3, 180e3, 220e3, 270e3, 330e3, 390e3, 470e3, 560e3, 680e3, 820e3,
+    1e6, 2.2e6, 3.3e6, 4.7e6
+};
+
+typedef struct {
+    double R;
+    int n, i;
+} Entry;
+
+static int compare_entries(const void *a, const void *b)
+{
+    const Entry *ea = (const Entry *)a;
+    const Entry *eb = (const Entry *)b;
+    if (ea->R < eb->R) return -1;
+    if (ea->R > eb->R) return 1;
+    /* Equal R: fewer parts first, then enumeration order */
+    if (ea->n != eb->n) return ea->n - eb->n;
+    return ea->i - eb->i;
+}
+
+static void put_u32(FILE *fp, uint32_t v)
+{
+    unsigned char b[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff };
+    fwrite(b, 1, 4, fp);
+}
+
+static void put_f64(FILE *fp, double v)
+{
+    unsigned char b[8];
+    uint64_t bits;
+    int k;
+
+    memcpy(&bits, &v, 8);
+    for (k = 0; k < 8; k++)
+        b[k] = (bits >> (8 * k)) & 0xff;
+    fwrite(b, 1, 8, fp);
+}
+
+static int value_index(const double *values, int count, double v)
+{
+    int k;
+    for (k = 0; k < count; k++)
+        if (values[k] == v)
+            return k;
+    return -1;
+}
+
+static int write_table(const double *values, int count, const char *path)
+{
+    NetworkSet set;
+    Part parts[256];
+    Entry *entries;
+    FILE *fp;
+    int i, n, k, total = 0;
+
+    for (i = 0; i < count; i++) {
+        parts[i].R = values[i];
+        parts[i].tol = 0.01;
+        parts[i].tcr = 0;
+        parts[i].power = 0;
+    }
+    if (network_set_build(&set, parts, count) != 0)
+        return -1;
+
+    for (n = 1; n <= MAX_N; n++)
+        total += set.count[n];
+    entries = malloc(total * sizeof(Entry));
+    if (!entries) {
+        network_set_free(&set);
+        return -1;
+    }
+    total = 0;
+    for (n = 1; n <= MAX_N; n++)
+        for (i = 0; i < set.count[n]; i++) {
+            entries[total].R = set.level[n][i].R;
+            entries[total].n = n;
+            entries[total].i = i;
+            total++;
+        }
+    qsort(entries, total, sizeof(Entry), compare_entries);
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        free(entries);
+        network_set_free(&set);
+        return -1;
+    }
+    fwrite("RNT1", 1, 4, fp);
+    put_u32(fp, (uint32_t)count);
+    put_u32(fp, (uint32_t)total);
+    put_u32(fp, STRIDE);
+    for (i = 0; i < count; i++)
+        put_f64(fp, values[i]);
+    for (i = 0; i < total; i++)
+        put_f64(fp, entries[i].R);
+    for (i = 0; i < total; i++)
+        fputc(entries[i].n, fp);
+    for (i = 0; i < total; i++) {
+        NetProgram prog;
+        unsigned char code[STRIDE] = { 0 };
+        int leaf = 0;
+
+        network_compile(&set, entries[i].n, entries[i].i, &prog);
+        for (k = 0; k < prog.num_ops; k++) {
+            if (prog.op[k] == NET_LEAF)
+                code[k] = (unsigned char)value_index(values, count, prog.leaf[leaf++]);
+            else
+                code[k] = prog.op[k] == NET_SERIES ? OP_SERIES : OP_PARALLEL;
+        }
+        fwrite(code, 1, STRIDE, fp);
+    }
+
+    free(entries);
+    network_set_free(&set);
+    if (fclose(fp) != 0)
+        return -1;
+    printf("  %s: %d values, %d networks\n", path, count, total);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char path[1024];
+    const char *dir = argc > 1 ? argv[1] : "web/tables";
+
+    snprintf(path, sizeof(path), "%s/standard.bin", dir);
+    if (write_table(STANDARD, (int)(sizeof(STANDARD) / sizeof(STANDARD[0])), path) != 0) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
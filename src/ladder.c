@@ -0,0 +1,1350 @@
+/*
+ * ladder.c - R-2R ladder DAC model
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "ladder.h"
+#include "parallel.h"
+#include "network.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define LO_BITS_MAX 12             /* low half of the code for table lookups */
+
+/* ========================================================================
+ * CONSTRUCTION
+ * ======================================================================== */
+
+void ladder_init_ideal(Ladder *lad, int bits, double R)
+{
+    int k;
+
+    if (bits < 1) bits = 1;
+    if (bits > MAX_R2R_BITS) bits = MAX_R2R_BITS;
+    memset(lad, 0, sizeof(*lad));
+    lad->bits = bits;
+    for (k = 0; k < bits; k++) {
+        lad->r[k] = k < bits - 1 ? R : 0;
+        lad->r2[k] = 2 * R;
+    }
+    lad->term = 2 * R;
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Relative deviation within ±tol: sum of three uniforms, so sigma is
+ * tol/3 and the tails stop at the tolerance limit.
+ */
+static double tolerance_draw(uint64_t *state, double tol)
+{
+    uint64_t x = splitmix64(state);
+    double u = (double)(x & 0x1FFFFF) + (double)((x >> 21) & 0x1FFFFF) +
+               (double)((x >> 42) & 0x1FFFFF);
+    return tol * (u * (2.0 / (3.0 * 0x1FFFFF)) - 1.0);
+}
+
+static void sample_parts(Ladder *lad, int bits, double R, double tol, uint64_t *state)
+{
+    int k;
+
+    ladder_init_ideal(lad, bits, R);
+    for (k = 0; k < lad->bits; k++) {
+        if (k < lad->bits - 1)
+            lad->r[k] *= 1.0 + tolerance_draw(state, tol);
+        lad->r2[k] *= 1.0 + tolerance_draw(state, tol);
+    }
+    lad->term *= 1.0 + tolerance_draw(state, tol);
+}
+
+void ladder_sample(Ladder *lad, int bits, double R, double tol, unsigned long seed)
+{
+    uint64_t state = (uint64_t)seed;
+    sample_parts(lad, bits, R, tol, &state);
+}
+
+int ladder_load_csv(Ladder *lad, int bits, double R, const char *path)
+{
+    FILE *fp;
+    char line[256];
+    int loaded = 0;
+
+    ladder_init_ideal(lad, bits, R);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp)) {
+        char name[32], *c;
+        double ohms;
+        int k;
+
+        if (sscanf(line, " %31[^, \t] , %lf", name, &ohms) != 2 || ohms <= 0)
+            continue;  /* header, comment or malformed row */
+        for (c = name; *c; c++)
+            *c = (char)toupper((unsigned char)*c);
+
+        if (strcmp(name, "TERM") == 0) {
+            lad->term = ohms;
+        } else if (strcmp(name, "LOAD") == 0) {
+            lad->load = ohms;
+        } else if (sscanf(name, "RON%d", &k) == 1 && k >= 0 && k < lad->bits) {
+            lad->ron[k] = ohms;
+        } else if (sscanf(name, "2R%d", &k) == 1 && k >= 0 && k < lad->bits) {
+            lad->r2[k] = ohms;
+        } else if (sscanf(name, "R%d", &k) == 1 && k >= 0 && k < lad->bits - 1) {
+            lad->r[k] = ohms;
+        } else {
+            continue;
+        }
+        loaded++;
+    }
+    fclose(fp);
+    return loaded;
+}
+
+/* ========================================================================
+ * TRANSFER FUNCTION
+ * ======================================================================== */
+
+/*
+ * Thevenin sweep from the LSB end. At node k, beta[k] is the share of
+ * bit k's voltage and alpha[k] the share of node k-1's Thevenin voltage.
+ * The leg of bit k is its 2R plus the switch resistance. Returns the
+ * Thevenin resistance of the last node.
+ */
+static double ladder_sweep(const Ladder *lad, double *beta, double *alpha)
+{
+    double rth = 0, rin, leg;
+    int k;
+
+    /* Node 0: termination to GND in parallel with bit 0's leg */
+    rin = lad->term;
+    for (k = 0; k < lad->bits; k++) {
+        if (k > 0)
+            rin = rth + lad->r[k - 1];
+        leg = lad->r2[k] + lad->ron[k];
+        beta[k] = rin / (rin + leg);
+        alpha[k] = leg / (rin + leg);
+        rth = rin * leg / (rin + leg);
+    }
+    return rth;
+}
+
+void ladder_gains(const Ladder *lad, double *gain, double *zout)
+{
+    double alpha[MAX_R2R_BITS];
+    double rth, att;
+    int k;
+
+    rth = ladder_sweep(lad, gain, alpha);
+
+    /* The load divides the Thevenin source of the last node */
+    att = 1.0;
+    if (lad->load > 0) {
+        att = lad->load / (rth + lad->load);
+        rth = rth * lad->load / (rth + lad->load);
+    }
+    if (zout)
+        *zout = rth;
+
+    /* Each bit is attenuated by every node between it and the output */
+    for (k = lad->bits - 1; k >= 0; k--) {
+        gain[k] *= att;
+        att *= alpha[k];
+    }
+}
+
+double ladder_output(const Ladder *lad, long code)
+{
+    double gain[MAX_R2R_BITS];
+    double v = 0;
+    int k;
+
+    ladder_gains(lad, gain, NULL);
+    for (k = 0; k < lad->bits; k++)
+        if (code & (1L << k))
+            v += gain[k];
+    return v;
+}
+
+void ladder_output_batch(const Ladder *lad, const long *codes, double *vout, long count)
+{
+    double gain[MAX_R2R_BITS];
+    long i;
+    int k;
+
+    ladder_gains(lad, gain, NULL);
+    for (i = 0; i < count; i++) {
+        double v = 0;
+        for (k = 0; k < lad->bits; k++)
+            if (codes[i] & (1L << k))
+                v += gain[k];
+        vout[i] = v;
+    }
+}
+
+#define VARIANTS_PER_ITEM 256
+
+typedef struct {
+    const Ladder *lads;
+    int count;
+    double *gains, *zout;
+} GainsBatchJob;
+
+static void gains_batch_worker(int item, void *ctx)
+{
+    const GainsBatchJob *job = (const GainsBatchJob *)ctx;
+    int v = item * VARIANTS_PER_ITEM;
+    int last = v + VARIANTS_PER_ITEM < job->count ? v + VARIANTS_PER_ITEM : job->count;
+
+    for (; v < last; v++)
+        ladder_gains(&job->lads[v], job->gains + (long)v * MAX_R2R_BITS,
+                     job->zout ? &job->zout[v] : NULL);
+}
+
+void ladder_gains_batch(const Ladder *lads, int count, double *gains, double *zout)
+{
+    GainsBatchJob job;
+
+    job.lads = lads;
+    job.count = count;
+    job.gains = gains;
+    job.zout = zout;
+    parallel_for((count + VARIANTS_PER_ITEM - 1) / VARIANTS_PER_ITEM,
+                 gains_batch_worker, &job);
+}
+
+/* ========================================================================
+ * FULL-CODE LINEARITY
+ * ======================================================================== */
+
+typedef struct {
+    const double *vlo, *vhi;
+    int lo_bits;
+    long num_hi;
+    double inv_lsb;
+    LadderLinearity *part;         /* one per high-half value */
+} LinearityJob;
+
+/* Fill table[i] with the summed gains of bits [first, first+count) set in i */
+static void partial_sums(const double *gain, int first, int count, double *table)
+{
+    long i;
+    int k;
+
+    table[0] = 0;
+    for (k = 0; k < count; k++) {
+        long half = 1L << k;
+        for (i = 0; i < half; i++)
+            table[half + i] = table[i] + gain[first + k];
+    }
+}
+
+static void linearity_worker(int h, void *ctx)
+{
+    const LinearityJob *job = (const LinearityJob *)ctx;
+    LadderLinearity *out = &job->part[h];
+    const long block = 1L << job->lo_bits;
+    const long base = (long)h << job->lo_bits;
+    const double vh = job->vhi[h];
+    double prev, inl;
+    long l;
+
+    out->inl_max_code = out->inl_min_code = base;
+    out->dnl_max = -1e300;
+    out->dnl_min = 1e300;
+    out->dnl_max_code = out->dnl_min_code = base;
+    out->non_monotonic = 0;
+
+    prev = vh + job->vlo[0];
+    inl = prev * job->inv_lsb - (double)base;
+    out->inl_max = out->inl_min = inl;
+
+    for (l = 1; l <= block; l++) {
+        double v, dnl;
+        long code = base + l;
+
+        if (l == block) {
+            /* Step into the next block, if any */
+            if (h + 1 >= job->num_hi)
+                break;
+            v = job->vhi[h + 1] + job->vlo[0];
+        } else {
+            v = vh + job->vlo[l];
+            inl = v * job->inv_lsb - (double)code;
+            if (inl > out->inl_max) { out->inl_max = inl; out->inl_max_code = code; }
+            if (inl < out->inl_min) { out->inl_min = inl; out->inl_min_code = code; }
+        }
+        dnl = (v - prev) * job->inv_lsb - 1.0;
+        if (dnl > out->dnl_max) { out->dnl_max = dnl; out->dnl_max_code = code - 1; }
+        if (dnl < out->dnl_min) { out->dnl_min = dnl; out->dnl_min_code = code - 1; }
+        out->non_monotonic += v < prev;
+        prev = v;
+    }
+}
+
+int ladder_linearity(const Ladder *lad, LadderLinearity *lin)
+{
+    double gain[MAX_R2R_BITS];
+    LinearityJob job;
+    double *vlo, *vhi, full_scale;
+    int lo_bits, hi_bits, h;
+    long max_code = (1L << lad->bits) - 1;
+
+    ladder_gains(lad, gain, NULL);
+    lo_bits = lad->bits < LO_BITS_MAX ? lad->bits : LO_BITS_MAX;
+    hi_bits = lad->bits - lo_bits;
+
+    vlo = malloc(sizeof(double) << lo_bits);
+    vhi = malloc(sizeof(double) << hi_bits);
+    job.part = malloc(sizeof(LadderLinearity) << hi_bits);
+    if (!vlo || !vhi || !job.part) {
+        free(vlo);
+        free(vhi);
+        free(job.part);
+        return -1;
+    }
+    partial_sums(gain, 0, lo_bits, vlo);
+    partial_sums(gain, lo_bits, hi_bits, vhi);
+
+    job.vlo = vlo;
+    job.vhi = vhi;
+    job.lo_bits = lo_bits;
+    job.num_hi = 1L << hi_bits;
+    full_scale = vhi[job.num_hi - 1] + vlo[(1L << lo_bits) - 1];
+    /* Endpoint fit: code 0 is exactly 0 V, the LSB spans 0..full scale */
+    job.inv_lsb = (double)max_code / full_scale;
+
+    parallel_for((int)job.num_hi, linearity_worker, &job);
+
+    *lin = job.part[0];
+    lin->full_scale = full_scale;
+    lin->gain_error = full_scale * (double)(max_code + 1) / (double)max_code - 1.0;
+    for (h = 1; h < job.num_hi; h++) {
+        const LadderLinearity *p = &job.part[h];
+        if (p->inl_max > lin->inl_max) { lin->inl_max = p->inl_max; lin->inl_max_code = p->inl_max_code; }
+        if (p->inl_min < lin->inl_min) { lin->inl_min = p->inl_min; lin->inl_min_code = p->inl_min_code; }
+        if (p->dnl_max > lin->dnl_max) { lin->dnl_max = p->dnl_max; lin->dnl_max_code = p->dnl_max_code; }
+        if (p->dnl_min < lin->dnl_min) { lin->dnl_min = p->dnl_min; lin->dnl_min_code = p->dnl_min_code; }
+        lin->non_monotonic += p->non_monotonic;
+    }
+
+    free(vlo);
+    free(vhi);
+    free(job.part);
+    return 0;
+}
+
+/* ========================================================================
+ * CODE TABLE EXPORT
+ * ======================================================================== */
+
+#define EXPORT_CODES_PER_ITEM 16384
+#define EXPORT_ROW_MAX 64          /* longest CSV row */
+#define EXPORT_MAX_BATCH 16        /* chunks formatted per write round */
+
+typedef struct {
+    const double *vlo, *vhi;
+    int lo_bits, bits;
+    double vref;
+    int format;
+    long num_codes;
+    int first;                     /* first chunk of the current round */
+    char **buf;                    /* per-slot output buffers */
+    size_t *len;
+} ExportJob;
+
+static char *put_uint(char *p, uint64_t v)
+{
+    char tmp[24];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+/* Fixed-point with 9 decimals; much faster than printf for big tables */
+static char *put_volts(char *p, double v)
+{
+    uint64_t scaled, frac;
+    int d;
+
+    if (v < 0) {
+        *p++ = '-';
+        v = -v;
+    }
+    scaled = (uint64_t)(v * 1e9 + 0.5);
+    p = put_uint(p, scaled / 1000000000u);
+    *p++ = '.';
+    frac = scaled % 1000000000u;
+    for (d = 8; d >= 0; d--) {
+        p[d] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    return p + 9;
+}
+
+static void export_worker(int slot, void *ctx)
+{
+    const ExportJob *job = (const ExportJob *)ctx;
+    const long lo_mask = (1L << job->lo_bits) - 1;
+    const double ideal_step = job->vref / (double)(1L << job->bits);
+    long code = (long)(job->first + slot) * EXPORT_CODES_PER_ITEM;
+    long last = code + EXPORT_CODES_PER_ITEM;
+    char *p = job->buf[slot];
+
+    if (last > job->num_codes)
+        last = job->num_codes;
+
+    for (; code < last; code++) {
+        double v = job->vref * (job->vhi[code >> job->lo_bits] + job->vlo[code & lo_mask]);
+
+        if (job->format == LADDER_EXPORT_CSV) {
+            p = put_uint(p, (uint64_t)code);
+            *p++ = ',';
+            p = put_volts(p, ideal_step * (double)code);
+            *p++ = ',';
+            p = put_volts(p, v);
+            *p++ = '\n';
+        } else if (job->format == LADDER_EXPORT_F32) {
+            float f = (float)v;
+            memcpy(p, &f, sizeof(f));
+            p += sizeof(f);
+        } else {
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        }
+    }
+    job->len[slot] = (size_t)(p - job->buf[slot]);
+}
+
+int ladder_export(const Ladder *lad, double vref, int format, const char *path)
+{
+    double gain[MAX_R2R_BITS];
+    double *vlo = NULL, *vhi = NULL;
+    char *bufs[EXPORT_MAX_BATCH] = { 0 };
+    size_t lens[EXPORT_MAX_BATCH];
+    ExportJob job;
+    FILE *fp;
+    int hi_bits, batch, num_items, i, rc = -1;
+
+    /* put_volts needs v * 1e9 to fit in uint64 */
+    if (!(vref > 0 && vref <= MAX_EXPORT_VREF))
+        return -1;
+
+    ladder_gains(lad, gain, NULL);
+    job.bits = lad->bits;
+    job.lo_bits = lad->bits < LO_BITS_MAX ? lad->bits : LO_BITS_MAX;
+    hi_bits = lad->bits - job.lo_bits;
+    job.vref = vref;
+    job.format = format;
+    job.num_codes = 1L << lad->bits;
+    job.buf = bufs;
+    job.len = lens;
+
+    num_items = (int)((job.num_codes + EXPORT_CODES_PER_ITEM - 1) / EXPORT_CODES_PER_ITEM);
+    batch = parallel_num_threads() * 2;
+    if (batch > EXPORT_MAX_BATCH) batch = EXPORT_MAX_BATCH;
+    if (batch > num_items) batch = num_items;
+
+    fp = fopen(path, format == LADDER_EXPORT_CSV ? "w" : "wb");
+    if (!fp)
+        return -1;
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    vlo = malloc(sizeof(double) << job.lo_bits);
+    vhi = malloc(sizeof(double) << hi_bits);
+    if (!vlo || !vhi)
+        goto cleanup;
+    partial_sums(gain, 0, job.lo_bits, vlo);
+    partial_sums(gain, job.lo_bits, hi_bits, vhi);
+    job.vlo = vlo;
+    job.vhi = vhi;
+    for (i = 0; i < batch; i++) {
+        bufs[i] = malloc(EXPORT_CODES_PER_ITEM * EXPORT_ROW_MAX);
+        if (!bufs[i])
+            goto cleanup;
+    }
+
+    if (format == LADDER_EXPORT_CSV && fputs("code,ideal_v,actual_v\n", fp) == EOF)
+        goto cleanup;
+
+    /* Format a round of chunks in parallel, then write them in order */
+    for (job.first = 0; job.first < num_items; job.first += batch) {
+        int count = num_items - job.first < batch ? num_items - job.first : batch;
+
+        parallel_for(count, export_worker, &job);
+        for (i = 0; i < count; i++)
+            if (fwrite(bufs[i], 1, lens[i], fp) != lens[i])
+                goto cleanup;
+    }
+    rc = 0;
+
+cleanup:
+    if (fclose(fp) != 0)
+        rc = -1;
+    for (i = 0; i < batch; i++)
+        free(bufs[i]);
+    free(vlo);
+    free(vhi);
+    return rc;
+}
+
+/* ========================================================================
+ * MONTE CARLO MISMATCH
+ * ======================================================================== */
+
+#define MC_TRIALS_PER_ITEM 1024
+
+/*
+ * Worst linearity of an n-bit ladder from its bit gains (any common
+ * scale): DNL is only evaluated at the n carry transitions and the INL
+ * extremes are the sums of the positive and negative per-bit errors.
+ */
+static void carry_linearity(const double *h, int n, double *dnl_abs,
+                            double *dnl_min, double *inl_abs)
+{
+    double fs = 0, below = 0, scale, pos = 0, neg = 0;
+    int k;
+
+    for (k = 0; k < n; k++)
+        fs += h[k];
+    scale = (double)((1L << n) - 1) / fs;
+
+    *dnl_abs = 0;
+    *dnl_min = 0;
+    for (k = 0; k < n; k++) {
+        /* Carry into bit k: bit k turns on, bits below turn off */
+        double dnl = (h[k] - below) * scale - 1.0;
+        double e = h[k] * scale - (double)(1L << k);
+
+        if (fabs(dnl) > *dnl_abs) *dnl_abs = fabs(dnl);
+        if (dnl < *dnl_min) *dnl_min = dnl;
+        if (e > 0) pos += e; else neg += e;
+        below += h[k];
+    }
+    *inl_abs = neg < -pos ? -neg : pos;
+}
+
+typedef struct {
+    const LadderMcConfig *cfg;
+    float *dnl;                    /* [size][trial] max |DNL| */
+    float *inl;                    /* [size][trial] max |INL| */
+    unsigned char *monotonic;      /* [size][trial] every DNL > -1 */
+} LadderMcJob;
+
+static void ladder_mc_worker(int item, void *ctx)
+{
+    const LadderMcJob *job = (const LadderMcJob *)ctx;
+    const LadderMcConfig *cfg = job->cfg;
+    const int bits = cfg->bits;
+    long t, first = (long)item * MC_TRIALS_PER_ITEM;
+    long last = first + MC_TRIALS_PER_ITEM;
+
+    if (last > cfg->trials)
+        last = cfg->trials;
+
+    for (t = first; t < last; t++) {
+        double beta[MAX_R2R_BITS], alpha[MAX_R2R_BITS], h[MAX_R2R_BITS];
+        double att = 1.0;
+        uint64_t state = ((uint64_t)cfg->seed << 32) ^ (uint64_t)t;
+        Ladder lad;
+        int n, k;
+
+        state = splitmix64(&state);
+        sample_parts(&lad, bits, 1.0, cfg->tol, &state);
+        for (k = 0; k < bits; k++)
+            lad.ron[k] = cfg->ron;
+        ladder_sweep(&lad, beta, alpha);
+
+        /*
+         * Gains relative to node k: the attenuation from node k to the
+         * output is common to every bit below it, so h[] serves every
+         * ladder size after endpoint normalization.
+         */
+        for (k = 0; k < bits; k++) {
+            att *= alpha[k];
+            h[k] = beta[k] / att;
+        }
+
+        for (n = 2; n <= bits; n++) {
+            double dnl_abs, dnl_min, inl_abs;
+            long idx = (long)(n - 2) * cfg->trials + t;
+
+            carry_linearity(h, n, &dnl_abs, &dnl_min, &inl_abs);
+            job->dnl[idx] = (float)dnl_abs;
+            job->inl[idx] = (float)inl_abs;
+            job->monotonic[idx] = dnl_min > -1.0;
+        }
+    }
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static double percentile(const float *sorted, long count, double p)
+{
+    long i = (long)(p * (double)(count - 1) + 0.5);
+    return sorted[i];
+}
+
+/* Distribution summary of one size's trials (sorts dnl and inl) */
+static void summarize_trials(float *dnl, float *inl, const unsigned char *mono,
+                             long trials, LadderMcStats *st)
+{
+    long t, n_mono = 0, n_dnl = 0, n_inl = 0;
+
+    for (t = 0; t < trials; t++) {
+        n_mono += mono[t];
+        n_dnl += dnl[t] <= 1.0f;
+        n_inl += inl[t] <= 0.5f;
+    }
+    qsort(dnl, trials, sizeof(float), compare_float);
+    qsort(inl, trials, sizeof(float), compare_float);
+
+    st->dnl_p50 = percentile(dnl, trials, 0.50);
+    st->dnl_p90 = percentile(dnl, trials, 0.90);
+    st->dnl_p99 = percentile(dnl, trials, 0.99);
+    st->dnl_worst = dnl[trials - 1];
+    st->inl_p50 = percentile(inl, trials, 0.50);
+    st->inl_p90 = percentile(inl, trials, 0.90);
+    st->inl_p99 = percentile(inl, trials, 0.99);
+    st->inl_worst = inl[trials - 1];
+    st->p_monotonic = (double)n_mono / (double)trials;
+    st->p_dnl_1lsb = (double)n_dnl / (double)trials;
+    st->p_inl_half_lsb = (double)n_inl / (double)trials;
+}
+
+int ladder_monte_carlo(const LadderMcConfig *cfg, LadderMcStats *stats)
+{
+    LadderMcJob job;
+    int sizes, s, items;
+    long total;
+
+    if (cfg->bits < 2 || cfg->bits > MAX_R2R_BITS || cfg->trials < 1)
+        return 0;
+
+    sizes = cfg->bits - 1;
+    total = (long)sizes * cfg->trials;
+    job.cfg = cfg;
+    job.dnl = malloc(total * sizeof(float));
+    job.inl = malloc(total * sizeof(float));
+    job.monotonic = malloc(total);
+    if (!job.dnl || !job.inl || !job.monotonic) {
+        free(job.dnl);
+        free(job.inl);
+        free(job.monotonic);
+        return -1;
+    }
+
+    items = (int)((cfg->trials + MC_TRIALS_PER_ITEM - 1) / MC_TRIALS_PER_ITEM);
+    parallel_for(items, ladder_mc_worker, &job);
+
+    for (s = 0; s < sizes; s++) {
+        long off = (long)s * cfg->trials;
+        summarize_trials(job.dnl + off, job.inl + off, job.monotonic + off,
+                         cfg->trials, &stats[s]);
+        stats[s].bits = s + 2;
+    }
+
+    free(job.dnl);
+    free(job.inl);
+    free(job.monotonic);
+    return sizes;
+}
+
+/* ========================================================================
+ * CALIBRATION LUT
+ * ======================================================================== */
+
+typedef struct {
+    double v;
+    unsigned long code;
+} CodeLevel;
+
+typedef struct {
+    const double *vlo, *vhi;
+    int lo_bits;
+    CodeLevel *levels;
+} LevelsJob;
+
+static void levels_worker(int h, void *ctx)
+{
+    const LevelsJob *job = (const LevelsJob *)ctx;
+    const long block = 1L << job->lo_bits;
+    const long base = (long)h << job->lo_bits;
+    long l;
+
+    for (l = 0; l < block; l++) {
+        job->levels[base + l].v = job->vhi[h] + job->vlo[l];
+        job->levels[base + l].code = (unsigned long)(base + l);
+    }
+}
+
+static int compare_levels(const void *a, const void *b)
+{
+    const CodeLevel *la = (const CodeLevel *)a, *lb = (const CodeLevel *)b;
+    if (la->v != lb->v)
+        return (la->v > lb->v) - (la->v < lb->v);
+    return (la->code > lb->code) - (la->code < lb->code);
+}
+
+int ladder_calibrate(const Ladder *lad, const LadderCalSpec *spec, LadderCal *cal)
+{
+    double gain[MAX_R2R_BITS];
+    LevelsJob job;
+    double *vlo = NULL, *vhi = NULL, step, lsb, sum_sq = 0;
+    long num_codes, i, j = 0;
+    int hi_bits;
+
+    memset(cal, 0, sizeof(*cal));
+    if (lad->bits > MAX_CAL_BITS || spec->depth < 1 || spec->depth > lad->bits ||
+        spec->interp_bits < 0 || spec->interp_bits > 8 || spec->v_lo < 0 ||
+        spec->v_hi <= spec->v_lo)
+        return -1;
+
+    cal->spec = *spec;
+    cal->bits = lad->bits;
+    cal->size = 1L << spec->depth;
+    num_codes = 1L << lad->bits;
+
+    ladder_gains(lad, gain, NULL);
+    job.lo_bits = lad->bits < LO_BITS_MAX ? lad->bits : LO_BITS_MAX;
+    hi_bits = lad->bits - job.lo_bits;
+    vlo = malloc(sizeof(double) << job.lo_bits);
+    vhi = malloc(sizeof(double) << hi_bits);
+    job.levels = malloc(num_codes * sizeof(CodeLevel));
+    cal->code = malloc(cal->size * sizeof(unsigned long));
+    if (!vlo || !vhi || !job.levels || !cal->code) {
+        free(vlo);
+        free(vhi);
+        free(job.levels);
+        ladder_cal_free(cal);
+        return -1;
+    }
+    partial_sums(gain, 0, job.lo_bits, vlo);
+    partial_sums(gain, job.lo_bits, hi_bits, vhi);
+    job.vlo = vlo;
+    job.vhi = vhi;
+
+    /* Real output of every code, then ordered by voltage */
+    parallel_for(1 << hi_bits, levels_worker, &job);
+    qsort(job.levels, num_codes, sizeof(CodeLevel), compare_levels);
+
+    /* Targets ascend, so one pass over the sorted levels matches them all */
+    step = (spec->v_hi - spec->v_lo) / (double)(cal->size - 1 > 0 ? cal->size - 1 : 1);
+    lsb = 1.0 / (double)num_codes;
+    for (i = 0; i < cal->size; i++) {
+        double target = spec->v_lo + step * (double)i;
+        const CodeLevel *pick;
+        double err;
+
+        while (j + 1 < num_codes && job.levels[j + 1].v <= target)
+            j++;
+        pick = &job.levels[j];
+        /* pick->v > target only below the lowest level, which is then nearest */
+        if (spec->rounding == LADDER_CAL_NEAREST && j + 1 < num_codes && pick->v <= target &&
+            job.levels[j + 1].v - target < target - pick->v)
+            pick = &job.levels[j + 1];
+
+        cal->code[i] = pick->code;
+        err = fabs(pick->v - target) / lsb;
+        if (err > cal->max_error)
+            cal->max_error = err;
+        sum_sq += err * err;
+    }
+    cal->rms_error = sqrt(sum_sq / (double)cal->size);
+
+    free(vlo);
+    free(vhi);
+    free(job.levels);
+    return 0;
+}
+
+void ladder_cal_free(LadderCal *cal)
+{
+    free(cal->code);
+    cal->code = NULL;
+}
+
+int ladder_cal_write_header(const LadderCal *cal, const char *path, const char *ident)
+{
+    const char *type = cal->bits <= 16 ? "uint16_t" : "uint32_t";
+    char upper[64];
+    FILE *fp;
+    long i;
+    int k, rc;
+
+    for (k = 0; ident[k] && k < (int)sizeof(upper) - 1; k++)
+        upper[k] = (char)toupper((unsigned char)ident[k]);
+    upper[k] = '\0';
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+
+    fprintf(fp,
+        "/*\n"
+        " * %s - R-2R ladder calibration table\n"
+        " *\n"
+        " * Generated by resistorcal. Entry i holds the %d-bit ladder code whose\n"
+        " * measured output is %s %.9f + i * %.9g of Vref.\n"
+        " * Worst error %.3f LSB, RMS %.3f LSB at the table points.\n"
+        " */\n\n"
+        "#ifndef %s_H\n#define %s_H\n\n#include <stdint.h>\n\n"
+        "#define %s_LADDER_BITS %d\n"
+        "#define %s_INDEX_BITS %d\n"
+        "#define %s_INTERP_BITS %d\n"
+        "#define %s_SIZE %ldu\n\n"
+        "static const %s %s_table[%s_SIZE] = {",
+        ident, cal->bits,
+        cal->spec.rounding == LADDER_CAL_BELOW ? "the highest not above" : "nearest to",
+        cal->spec.v_lo,
+        (cal->spec.v_hi - cal->spec.v_lo) / (double)(cal->size > 1 ? cal->size - 1 : 1),
+        cal->max_error, cal->rms_error,
+        upper, upper, upper, cal->bits, upper, cal->spec.depth,
+        upper, cal->spec.interp_bits, upper, cal->size, type, ident, upper);
+
+    for (i = 0; i < cal->size; i++)
+        fprintf(fp, "%s%lu%s", i % 12 ? " " : "\n    ", cal->code[i],
+                i + 1 < cal->size ? "," : "\n};\n\n");
+
+    /* Input is INDEX_BITS + INTERP_BITS wide; the low bits interpolate */
+    fprintf(fp, "static inline %s %s_lookup(uint32_t x)\n{\n", type, ident);
+    if (cal->spec.interp_bits == 0) {
+        fprintf(fp, "    return %s_table[x & (%s_SIZE - 1)];\n}\n\n", ident, upper);
+    } else {
+        fprintf(fp,
+            "    uint32_t i = (x >> %s_INTERP_BITS) & (%s_SIZE - 1);\n"
+            "    int64_t f = (int64_t)(x & ((1u << %s_INTERP_BITS) - 1));\n"
+            "    int64_t a = %s_table[i];\n\n"
+            "    if (f == 0 || i + 1 >= %s_SIZE)\n"
+            "        return (%s)a;\n"
+            "    return (%s)(a + ((int64_t)%s_table[i + 1] - a) * f / (1 << %s_INTERP_BITS));\n"
+            "}\n\n",
+            upper, upper, upper, ident, upper, type, type, ident, upper);
+    }
+    fprintf(fp, "#endif /* %s_H */\n", upper);
+
+    rc = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0)
+        rc = -1;
+    return rc;
+}
+
+int ladder_cal_write_binary(const LadderCal *cal, const char *path)
+{
+    const int width = cal->bits <= 16 ? 2 : 4;
+    unsigned char bytes[4];
+    FILE *fp;
+    long i;
+    int b, rc;
+
+    fp = fopen(path, "wb");
+    if (!fp)
+        return -1;
+    for (i = 0; i < cal->size; i++) {
+        for (b = 0; b < width; b++)
+            bytes[b] = (unsigned char)(cal->code[i] >> (8 * b));
+        fwrite(bytes, 1, width, fp);
+    }
+    rc = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0)
+        rc = -1;
+    return rc;
+}
+
+/* ========================================================================
+ * INVENTORY SYNTHESIS
+ * ======================================================================== */
+
+#define SYNTH_MAX_LEG_PARTS 3
+
+/* A one- or two-part network of inventory values */
+typedef struct {
+    double R;
+    double s2;                     /* sum of squared part sensitivities */
+    double a, b;
+    int op;
+} LegPair;
+
+typedef struct {
+    const double *values;          /* sorted inventory */
+    int count;
+    const LegPair *pairs;          /* all two-part networks, sorted by R */
+    int num_pairs;
+    const LadderSynthSpec *spec;
+    LadderSynth *slots;            /* SYNTH_MAX_LEG_PARTS per inventory value */
+    int *valid;
+} SynthJob;
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static int compare_pairs(const void *a, const void *b)
+{
+    return compare_doubles(&((const LegPair *)a)->R, &((const LegPair *)b)->R);
+}
+
+static int compare_synth(const void *a, const void *b)
+{
+    const LadderSynth *sa = (const LadderSynth *)a, *sb = (const LadderSynth *)b;
+    if (sa->inl_p90 != sb->inl_p90)
+        return (sa->inl_p90 > sb->inl_p90) - (sa->inl_p90 < sb->inl_p90);
+    if (sa->parts != sb->parts)
+        return sa->parts - sb->parts;
+    if (sa->inl_nominal != sb->inl_nominal)
+        return (sa->inl_nominal > sb->inl_nominal) - (sa->inl_nominal < sb->inl_nominal);
+    return (sa->R > sb->R) - (sa->R < sb->R);
+}
+
+/* Combine two networks: value and sum of squared sensitivities */
+static double combine(int op, double a, double s2a, double b, double s2b, double *s2)
+{
+    double r;
+    if (op == NET_SERIES) {
+        r = a + b;
+        *s2 = (a / r) * (a / r) * s2a + (b / r) * (b / r) * s2b;
+    } else {
+        r = a * b / (a + b);
+        *s2 = (r / a) * (r / a) * s2a + (r / b) * (r / b) * s2b;
+    }
+    return r;
+}
+
+/* First index whose value is >= x */
+static int lower_bound_values(const double *v, int count, double x)
+{
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (v[mid] < x) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static int lower_bound_pairs(const LegPair *p, int count, double x)
+{
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (p[mid].R < x) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* Keep cand if it is closer to target than best (ties: smaller spread) */
+static void consider_leg(LadderSynth *best, const LadderSynth *cand, double target)
+{
+    double eb = fabs(best->leg - target), ec = fabs(cand->leg - target);
+    if (best->leg_parts == 0 || ec < eb * (1 - 1e-12) ||
+        (ec <= eb * (1 + 1e-12) && cand->leg_sigma < best->leg_sigma))
+        *best = *cand;
+}
+
+/* Monte Carlo p90 of max |INL| and |DNL| for rung R and leg L */
+static void synth_score(LadderSynth *cand, const LadderSynthSpec *spec,
+                        uint64_t state, float *inl, float *dnl)
+{
+    double beta[MAX_R2R_BITS], alpha[MAX_R2R_BITS], h[MAX_R2R_BITS];
+    double dnl_abs, dnl_min, inl_abs, att;
+    double leg_tol = spec->tol * cand->leg_sigma;
+    Ladder lad;
+    long t;
+    int k;
+
+    /* Nominal: the leg's ratio error alone */
+    ladder_init_ideal(&lad, spec->bits, cand->R);
+    for (k = 0; k < lad.bits; k++)
+        lad.r2[k] = cand->leg;
+    lad.term = cand->leg;
+    ladder_gains(&lad, h, NULL);
+    carry_linearity(h, lad.bits, &dnl_abs, &dnl_min, &inl_abs);
+    cand->inl_nominal = inl_abs;
+
+    for (t = 0; t < spec->trials; t++) {
+        for (k = 0; k < lad.bits; k++) {
+            lad.r[k] = k < lad.bits - 1 ? cand->R * (1.0 + tolerance_draw(&state, spec->tol)) : 0;
+            lad.r2[k] = cand->leg * (1.0 + tolerance_draw(&state, leg_tol));
+        }
+        lad.term = cand->leg * (1.0 + tolerance_draw(&state, leg_tol));
+
+        ladder_sweep(&lad, beta, alpha);
+        att = 1.0;
+        for (k = 0; k < lad.bits; k++) {
+            att *= alpha[k];
+            h[k] = beta[k] / att;
+        }
+        carry_linearity(h, lad.bits, &dnl_abs, &dnl_min, &inl_abs);
+        inl[t] = (float)inl_abs;
+        dnl[t] = (float)dnl_abs;
+    }
+    qsort(inl, spec->trials, sizeof(float), compare_float);
+    qsort(dnl, spec->trials, sizeof(float), compare_float);
+    cand->inl_p90 = percentile(inl, spec->trials, 0.90);
+    cand->dnl_p90 = percentile(dnl, spec->trials, 0.90);
+}
+
+static void synth_worker(int i, void *ctx)
+{
+    const SynthJob *job = (const SynthJob *)ctx;
+    const LadderSynthSpec *spec = job->spec;
+    const double R = job->values[i], target = 2 * R;
+    LadderSynth best[SYNTH_MAX_LEG_PARTS], cand;
+    float *inl, *dnl;
+    int a, j, p, idx;
+
+    memset(best, 0, sizeof(best));
+    memset(&cand, 0, sizeof(cand));
+    cand.R = R;
+
+    /* One part */
+    idx = lower_bound_values(job->values, job->count, target);
+    for (j = idx - 1; j <= idx; j++) {
+        if (j < 0 || j >= job->count)
+            continue;
+        cand.leg = cand.v[0] = job->values[j];
+        cand.leg_parts = 1;
+        cand.leg_sigma = 1.0;
+        consider_leg(&best[0], &cand, target);
+    }
+
+    /* Two parts: nearest pair network (includes R + R) */
+    if (spec->max_leg_parts >= 2) {
+        idx = lower_bound_pairs(job->pairs, job->num_pairs, target);
+        for (j = idx - 8; j < idx + 8; j++) {
+            const LegPair *lp;
+            if (j < 0 || j >= job->num_pairs)
+                continue;
+            lp = &job->pairs[j];
+            cand.leg = lp->R;
+            cand.v[0] = lp->a;
+            cand.v[1] = lp->b;
+            cand.op[0] = lp->op;
+            cand.leg_parts = 2;
+            cand.leg_sigma = sqrt(lp->s2);
+            consider_leg(&best[1], &cand, target);
+        }
+    }
+
+    /* Three parts: one part in series or parallel with a pair */
+    if (spec->max_leg_parts >= 3) {
+        for (a = 0; a < job->count; a++) {
+            double va = job->values[a];
+            int op;
+            for (op = NET_SERIES; op <= NET_PARALLEL; op++) {
+                double need;
+                if (op == NET_SERIES)
+                    need = target - va;
+                else
+                    need = va > target ? 1.0 / (1.0 / target - 1.0 / va) : -1;
+                if (need <= 0)
+                    continue;
+                idx = lower_bound_pairs(job->pairs, job->num_pairs, need);
+                for (j = idx - 1; j <= idx; j++) {
+                    const LegPair *lp;
+                    double s2;
+                    if (j < 0 || j >= job->num_pairs)
+                        continue;
+                    lp = &job->pairs[j];
+                    cand.leg = combine(op, va, 1.0, lp->R, lp->s2, &s2);
+                    cand.v[0] = va;
+                    cand.v[1] = lp->a;
+                    cand.v[2] = lp->b;
+                    cand.op[0] = op;
+                    cand.op[1] = lp->op;
+                    cand.leg_parts = 3;
+                    cand.leg_sigma = sqrt(s2);
+                    consider_leg(&best[2], &cand, target);
+                }
+            }
+        }
+    }
+
+    inl = malloc(spec->trials * sizeof(float));
+    dnl = malloc(spec->trials * sizeof(float));
+    for (p = 0; p < SYNTH_MAX_LEG_PARTS; p++) {
+        LadderSynth *out = &job->slots[i * SYNTH_MAX_LEG_PARTS + p];
+        /* Common random numbers: every candidate sees the same draws */
+        uint64_t state = (uint64_t)spec->seed;
+
+        job->valid[i * SYNTH_MAX_LEG_PARTS + p] = 0;
+        if (best[p].leg_parts == 0 || !inl || !dnl)
+            continue;
+        /* A larger leg must get closer to 2R or spread less */
+        if (p > 0 && best[p - 1].leg_parts &&
+            fabs(best[p].leg - target) >= fabs(best[p - 1].leg - target) &&
+            best[p].leg_sigma >= best[p - 1].leg_sigma)
+            continue;
+        *out = best[p];
+        out->parts = (spec->bits - 1) + (spec->bits + 1) * out->leg_parts;
+        synth_score(out, spec, splitmix64(&state), inl, dnl);
+        job->valid[i * SYNTH_MAX_LEG_PARTS + p] = 1;
+    }
+    free(inl);
+    free(dnl);
+}
+
+int ladder_synthesize(const double *inventory, int count, const LadderSynthSpec *spec,
+                      LadderSynth *results, int max_results)
+{
+    SynthJob job;
+    double *values;
+    LegPair *pairs;
+    LadderSynth *slots;
+    int *valid;
+    int i, j, n = 0, num_values = 0, num_pairs = 0;
+
+    if (count <= 0 || spec->bits < 2 || spec->bits > MAX_R2R_BITS || spec->trials < 1)
+        return 0;
+
+    values = malloc(count * sizeof(double));
+    pairs = malloc((size_t)count * (count + 1) * sizeof(LegPair));
+    slots = malloc((size_t)count * SYNTH_MAX_LEG_PARTS * sizeof(LadderSynth));
+    valid = malloc((size_t)count * SYNTH_MAX_LEG_PARTS * sizeof(int));
+    if (!values || !pairs || !slots || !valid) {
+        free(values);
+        free(pairs);
+        free(slots);
+        free(valid);
+        return -1;
+    }
+
+    /* Sorted, de-duplicated inventory */
+    for (i = 0; i < count; i++)
+        if (inventory[i] > 0)
+            values[num_values++] = inventory[i];
+    qsort(values, num_values, sizeof(double), compare_doubles);
+    for (i = 0, j = 0; i < num_values; i++)
+        if (j == 0 || values[i] != values[j - 1])
+            values[j++] = values[i];
+    num_values = j;
+
+    for (i = 0; i < num_values; i++) {
+        for (j = i; j < num_values; j++) {
+            int op;
+            for (op = NET_SERIES; op <= NET_PARALLEL; op++) {
+                LegPair *lp = &pairs[num_pairs++];
+                lp->R = combine(op, values[i], 1.0, values[j], 1.0, &lp->s2);
+                lp->a = values[i];
+                lp->b = values[j];
+                lp->op = op;
+            }
+        }
+    }
+    qsort(pairs, num_pairs, sizeof(LegPair), compare_pairs);
+
+    job.values = values;
+    job.count = num_values;
+    job.pairs = pairs;
+    job.num_pairs = num_pairs;
+    job.spec = spec;
+    job.slots = slots;
+    job.valid = valid;
+    parallel_for(num_values, synth_worker, &job);
+
+    for (i = 0; i < num_values * SYNTH_MAX_LEG_PARTS; i++)
+        if (valid[i])
+            slots[n++] = slots[i];
+    qsort(slots, n, sizeof(LadderSynth), compare_synth);
+    if (n > max_results)
+        n = max_results;
+    memcpy(results, slots, n * sizeof(LadderSynth));
+
+    free(values);
+    free(pairs);
+    free(slots);
+    free(valid);
+    return n;
+}
+
+/* ========================================================================
+ * SEGMENTED DAC
+ * ======================================================================== */
+
+#define MAX_THERM_LEGS ((1 << MAX_SEGMENT_BITS) - 1)
+
+typedef struct {
+    const LadderMcConfig *cfg;
+    int items_per_k;
+    float *dnl, *inl;              /* [k - 1][trial] */
+    unsigned char *monotonic;
+} SegmentJob;
+
+/*
+ * Worst DNL/INL of one segmented build. lsb holds the bits - k LSB
+ * section (unused when k == bits), link the series R to the output node
+ * and legs[] the 2^k - 1 thermometer legs; all relative to R.
+ */
+static void segmented_linearity(const Ladder *lsb, int bits, int k, double link,
+                                const double *legs, double term,
+                                double *dnl_abs, double *dnl_min, double *inl_abs)
+{
+    const int m = bits - k;
+    const int num_legs = (1 << k) - 1;
+    double g[MAX_R2R_BITS], branch, gsum, share, fs = 0, lsb_fs = 0, scale;
+    double below = 0, pos = 0, neg = 0, cum = 0, a, a_max = 0, a_min = 0;
+    int b, j;
+
+    /* Output node: thermometer legs plus the R-2R branch */
+    if (m > 0) {
+        ladder_gains(lsb, g, &branch);
+        branch += link;
+    } else {
+        branch = term;             /* fully thermometer: just the termination */
+    }
+    gsum = 1.0 / branch;
+    for (j = 0; j < num_legs; j++)
+        gsum += 1.0 / legs[j];
+    share = (1.0 / branch) / gsum;
+
+    for (b = 0; b < m; b++) {
+        g[b] *= share;
+        lsb_fs += g[b];
+    }
+    fs = lsb_fs;
+    for (j = 0; j < num_legs; j++)
+        fs += (1.0 / legs[j]) / gsum;
+    scale = (double)((1L << bits) - 1) / fs;
+
+    *dnl_abs = 0;
+    *dnl_min = 0;
+
+    /* R-2R part: carries inside the LSB code, repeated for every T */
+    for (b = 0; b < m; b++) {
+        double dnl = (g[b] - below) * scale - 1.0;
+        double e = g[b] * scale - (double)(1L << b);
+
+        if (fabs(dnl) > *dnl_abs) *dnl_abs = fabs(dnl);
+        if (dnl < *dnl_min) *dnl_min = dnl;
+        if (e > 0) pos += e; else neg += e;
+        below += g[b];
+    }
+
+    /* Thermometer part: step T -> T+1 drops the whole LSB code */
+    for (j = 0; j < num_legs; j++) {
+        double tg = (1.0 / legs[j]) / gsum;
+        double dnl = (tg - lsb_fs) * scale - 1.0;
+
+        if (fabs(dnl) > *dnl_abs) *dnl_abs = fabs(dnl);
+        if (dnl < *dnl_min) *dnl_min = dnl;
+        cum += tg;
+        a = cum * scale - (double)((long)(j + 1) << m);
+        if (a > a_max) a_max = a;
+        if (a < a_min) a_min = a;
+    }
+
+    /* INL(T, l) = A(T) + B(l), and T and l range independently */
+    pos += a_max;
+    neg += a_min;
+    *inl_abs = neg < -pos ? -neg : pos;
+}
+
+static void segment_worker(int item, void *ctx)
+{
+    const SegmentJob *job = (const SegmentJob *)ctx;
+    const LadderMcConfig *cfg = job->cfg;
+    const int k = 1 + item / job->items_per_k;
+    const int m = cfg->bits - k;
+    const int num_legs = (1 << k) - 1;
+    long t = (long)(item % job->items_per_k) * MC_TRIALS_PER_ITEM;
+    long last = t + MC_TRIALS_PER_ITEM;
+    double legs[MAX_THERM_LEGS];
+
+    if (last > cfg->trials)
+        last = cfg->trials;
+
+    for (; t < last; t++) {
+        /* Same draws for every k: only the topology differs */
+        uint64_t state = ((uint64_t)cfg->seed << 32) ^ (uint64_t)t;
+        double dnl_abs, dnl_min, inl_abs, link, term = 0;
+        long idx = (long)(k - 1) * cfg->trials + t;
+        Ladder lsb;
+        int j;
+
+        state = splitmix64(&state);
+        if (m > 0) {
+            sample_parts(&lsb, m, 1.0, cfg->tol, &state);
+            for (j = 0; j < m; j++)
+                lsb.ron[j] = cfg->ron;
+        } else {
+            term = 2.0 * (1.0 + tolerance_draw(&state, cfg->tol));
+        }
+        link = 1.0 + tolerance_draw(&state, cfg->tol);
+        for (j = 0; j < num_legs; j++)
+            legs[j] = 2.0 * (1.0 + tolerance_draw(&state, cfg->tol)) + cfg->ron;
+
+        segmented_linearity(&lsb, cfg->bits, k, link, legs, term,
+                            &dnl_abs, &dnl_min, &inl_abs);
+        job->dnl[idx] = (float)dnl_abs;
+        job->inl[idx] = (float)inl_abs;
+        job->monotonic[idx] = dnl_min > -1.0;
+    }
+}
+
+int ladder_segmented_mc(const LadderMcConfig *cfg, int max_k, LadderSegment *out)
+{
+    SegmentJob job;
+    long total;
+    int k;
+
+    if (cfg->bits < 2 || cfg->bits > MAX_R2R_BITS || cfg->trials < 1)
+        return 0;
+    if (max_k > cfg->bits) max_k = cfg->bits;
+    if (max_k > MAX_SEGMENT_BITS) max_k = MAX_SEGMENT_BITS;
+    if (max_k < 1)
+        return 0;
+
+    total = (long)max_k * cfg->trials;
+    job.cfg = cfg;
+    job.items_per_k = (int)((cfg->trials + MC_TRIALS_PER_ITEM - 1) / MC_TRIALS_PER_ITEM);
+    job.dnl = malloc(total * sizeof(float));
+    job.inl = malloc(total * sizeof(float));
+    job.monotonic = malloc(total);
+    if (!job.dnl || !job.inl || !job.monotonic) {
+        free(job.dnl);
+        free(job.inl);
+        free(job.monotonic);
+        return -1;
+    }
+
+    parallel_for(max_k * job.items_per_k, segment_worker, &job);
+
+    for (k = 1; k <= max_k; k++) {
+        long off = (long)(k - 1) * cfg->trials;
+        out[k - 1].k = k;
+        out[k - 1].parts = 2 * (cfg->bits - k) + (1 << k);
+        summarize_trials(job.dnl + off, job.inl + off, job.monotonic + off,
+                         cfg->trials, &out[k - 1].lin);
+        out[k - 1].lin.bits = cfg->bits;
+    }
+
+    free(job.dnl);
+    free(job.inl);
+    free(job.monotonic);
+    return max_k;
+}
@@ -0,0 +1,236 @@
+/*
+ * ladder.h - R-2R ladder DAC model
+ *
+ * Voltage-mode ladder: node 0 (LSB) is terminated by 2R to GND, each
+ * node k has a 2R leg to bit k's switch (Vref or GND) and a series R to
+ * node k+1. The output is node bits-1 (MSB). Every resistor can take a
+ * real (sampled or measured) value. Switches are modelled by an on-
+ * resistance in series with each leg (the same to Vref and to GND), and
+ * the output can drive a resistive load to GND.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RESISTORCAL_LADDER_H
+#define RESISTORCAL_LADDER_H
+
+#define MAX_R2R_BITS 24   /* max bits for R-2R ladder */
+
+typedef struct {
+    int bits;
+    double r[MAX_R2R_BITS];        /* series R from node k to node k+1 */
+    double r2[MAX_R2R_BITS];       /* 2R leg of bit k (bit 0 = LSB) */
+    double term;                   /* 2R termination from node 0 to GND */
+    double ron[MAX_R2R_BITS];      /* switch on-resistance of bit k */
+    double load;                   /* output load to GND (0 = unloaded) */
+} Ladder;
+
+/* Linearity of the full code range, endpoint-fit, in LSB */
+typedef struct {
+    double inl_max, inl_min;
+    long inl_max_code, inl_min_code;
+    double dnl_max, dnl_min;       /* DNL(c) is the step from c to c+1 */
+    long dnl_max_code, dnl_min_code;
+    long non_monotonic;            /* codes where the output steps down */
+    double full_scale;             /* Vout/Vref at the all-ones code */
+    double gain_error;             /* relative to the ideal full scale */
+} LadderLinearity;
+
+/* Code table export formats */
+enum {
+    LADDER_EXPORT_CSV = 0,         /* code,ideal_v,actual_v rows */
+    LADDER_EXPORT_F32,             /* actual Vout per code, native float32 */
+    LADDER_EXPORT_F64              /* actual Vout per code, native float64 */
+};
+
+#define MAX_CAL_BITS 20     /* largest ladder a calibration LUT is built for */
+#define MAX_EXPORT_VREF 1e6 /* largest Vref (volts) a code table is exported for */
+
+/* How a LUT entry picks its code */
+enum {
+    LADDER_CAL_NEAREST = 0,        /* closest output voltage */
+    LADDER_CAL_BELOW               /* closest output not above the target */
+};
+
+/* Calibration LUT request: entry i targets v_lo + i * step (fractions of Vref) */
+typedef struct {
+    int depth;                     /* LUT index bits (2^depth entries) */
+    int interp_bits;               /* input bits interpolated between entries */
+    int rounding;                  /* LADDER_CAL_* */
+    double v_lo, v_hi;             /* target range, Vout/Vref (0 <= v_lo < v_hi) */
+} LadderCalSpec;
+
+typedef struct {
+    LadderCalSpec spec;
+    int bits;                      /* ladder bits (code width) */
+    long size;                     /* entries */
+    unsigned long *code;           /* best code per entry */
+    double max_error;              /* worst |Vout - target|, in ideal LSB */
+    double rms_error;
+} LadderCal;
+
+/* Ladder synthesis from a parts inventory */
+typedef struct {
+    int bits;
+    double tol;                    /* part tolerance, relative */
+    int max_leg_parts;             /* parts per 2R leg (1-3) */
+    long trials;                   /* Monte Carlo trials per candidate */
+    unsigned long seed;
+} LadderSynthSpec;
+
+typedef struct {
+    double R;                      /* rung resistor (one part) */
+    double leg;                    /* nominal 2R leg */
+    int leg_parts;
+    double v[3];                   /* leg = v0, v0 op0 v1 or v0 op0 (v1 op1 v2) */
+    int op[2];                     /* NET_SERIES or NET_PARALLEL */
+    double leg_sigma;              /* leg spread relative to a single part */
+    double inl_nominal;            /* max |INL| with nominal values, LSB */
+    double inl_p90, dnl_p90;       /* Monte Carlo max |INL| / |DNL|, LSB */
+    int parts;                     /* parts in the whole ladder */
+} LadderSynth;
+
+/* Monte Carlo mismatch settings (part tolerance is taken as 3 sigma) */
+typedef struct {
+    int bits;                      /* largest ladder analysed */
+    double tol;                    /* part tolerance, relative */
+    long trials;
+    unsigned long seed;
+    double ron;                    /* switch on-resistance, relative to R */
+} LadderMcConfig;
+
+/* Distribution of the worst-code linearity of one bit count, in LSB */
+typedef struct {
+    int bits;
+    double dnl_p50, dnl_p90, dnl_p99, dnl_worst;   /* max |DNL| per ladder */
+    double inl_p50, inl_p90, inl_p99, inl_worst;   /* max |INL| per ladder */
+    double p_monotonic;            /* fraction with every DNL > -1 */
+    double p_dnl_1lsb;             /* fraction with max |DNL| <= 1 LSB */
+    double p_inl_half_lsb;         /* fraction with max |INL| <= 0.5 LSB */
+} LadderMcStats;
+
+#define MAX_SEGMENT_BITS 10 /* thermometer MSBs (2^k - 1 unit legs) */
+
+/*
+ * Segmented DAC: an (bits - k)-bit R-2R section feeds the output node
+ * through a series R, and 2^k - 1 thermometer-coded 2R unit legs drive
+ * the output node directly. k = 1 is the plain R-2R ladder.
+ */
+typedef struct {
+    int k;                         /* thermometer bits */
+    int parts;                     /* resistors needed */
+    LadderMcStats lin;             /* Monte Carlo linearity (lin.bits = total bits) */
+} LadderSegment;
+
+/* Nominal ladder: every R equals R, every 2R equals 2R, ideal switches, no load */
+void ladder_init_ideal(Ladder *lad, int bits, double R);
+
+/*
+ * Draw every resistor of a nominal ladder within tol (taken as 3 sigma,
+ * hard-limited to ±tol). The same seed gives the same ladder.
+ */
+void ladder_sample(Ladder *lad, int bits, double R, double tol, unsigned long seed);
+
+/*
+ * Load measured values from a CSV file of "name,ohms" rows, where name
+ * is R<k>, 2R<k>, TERM, RON<k> or LOAD. Missing entries keep their
+ * nominal value.
+ * Returns the number of values read, or -1 if the file cannot be read.
+ */
+int ladder_load_csv(Ladder *lad, int bits, double R, const char *path);
+
+/*
+ * Per-bit output gains: Vout/Vref = sum of gain[k] over the set bits
+ * (superposition). Computed in O(bits) with a Thevenin sweep from the
+ * LSB end, including switch resistance and load. zout, if not NULL,
+ * receives the output resistance seen by the load's node.
+ */
+void ladder_gains(const Ladder *lad, double *gain, double *zout);
+
+/* Vout/Vref for one code */
+double ladder_output(const Ladder *lad, long code);
+
+/* Vout/Vref for count codes of one ladder (gains are solved once) */
+void ladder_output_batch(const Ladder *lad, const long *codes, double *vout, long count);
+
+/*
+ * Solve count ladder variants: gains[v * MAX_R2R_BITS + k] receives bit
+ * k's gain of variant v, zout[v] (if not NULL) its output resistance.
+ * Large batches run multi-threaded.
+ */
+void ladder_gains_batch(const Ladder *lads, int count, double *gains, double *zout);
+
+/*
+ * INL/DNL over all 2^bits codes. Each code costs one add: the code is
+ * split into high and low halves with precomputed partial sums. Runs
+ * multi-threaded. Returns 0, or -1 on allocation failure.
+ */
+int ladder_linearity(const Ladder *lad, LadderLinearity *lin);
+
+/*
+ * Monte Carlo mismatch: each trial draws a cfg->bits ladder and reports
+ * the worst DNL/INL of every ladder size 2..cfg->bits. Sizes share one
+ * draw because a smaller ladder's gains are the LSB gains of the larger
+ * one up to a common factor. DNL only depends on the carry transitions
+ * (step into bit t from t trailing ones), and the endpoint-fit INL
+ * extremes are the sums of the positive and negative per-bit errors, so
+ * a trial costs O(bits^2) instead of 2^bits. Runs multi-threaded and is
+ * deterministic for a given seed. stats receives cfg->bits - 1 entries
+ * (2 bits first). Returns the entry count, or -1 on allocation failure.
+ */
+int ladder_monte_carlo(const LadderMcConfig *cfg, LadderMcStats *stats);
+
+/*
+ * Write the full code -> voltage table (all 2^bits codes, Vref = vref)
+ * to path. Codes are produced in fixed-size chunks that worker threads
+ * format in parallel and the caller writes in order, so memory stays
+ * bounded whatever the bit count. Returns 0, or -1 if vref is not in
+ * (0, MAX_EXPORT_VREF], the file cannot be written or memory runs out.
+ */
+int ladder_export(const Ladder *lad, double vref, int format, const char *path);
+
+/*
+ * Build a firmware correction LUT for a ladder of at most MAX_CAL_BITS
+ * bits: every code's real output is solved, the outputs are sorted (so
+ * non-monotonic ladders are handled) and each target is matched in one
+ * merge pass. Returns 0, or -1 on allocation failure or bad spec.
+ * Free with ladder_cal_free.
+ */
+int ladder_calibrate(const Ladder *lad, const LadderCalSpec *spec, LadderCal *cal);
+void ladder_cal_free(LadderCal *cal);
+
+/*
+ * Write the LUT as a C header named after ident (table, size macros and
+ * an interpolating lookup function), or as a raw little-endian array of
+ * 16-bit (ladders up to 16 bits) or 32-bit codes. Return 0 or -1.
+ */
+int ladder_cal_write_header(const LadderCal *cal, const char *path, const char *ident);
+int ladder_cal_write_binary(const LadderCal *cal, const char *path);
+
+/*
+ * Find ladders buildable from the inventory: every value is tried as R
+ * (in parallel), and for each the 2R legs (and termination) are built
+ * from 1, 2 or 3 inventory parts - the closest single part, the closest
+ * series/parallel pair, and the closest part combined with a pair. Each
+ * candidate is scored by Monte Carlo max |INL|, which includes the
+ * nominal ratio error, with leg spread from the combination's
+ * sensitivities. All candidates share the same random draws, so their
+ * differences are not sampling noise. Results are sorted by p90 INL,
+ * then part count.
+ * Returns the number of results, or -1 on allocation failure.
+ */
+int ladder_synthesize(const double *inventory, int count, const LadderSynthSpec *spec,
+                      LadderSynth *results, int max_results);
+
+/*
+ * Monte Carlo linearity of every segmentation k = 1..max_k of a
+ * cfg->bits DAC. Per trial, the R-2R section's gains come from the
+ * Thevenin sweep and the output node divides by conductances, so the
+ * INL extremes split into a thermometer term and an R-2R term and a
+ * trial costs O(bits + 2^k). Trials and k values run in parallel and
+ * every k sees the same random draws. Returns the number of entries
+ * written to out, or -1 on allocation failure.
+ */
+int ladder_segmented_mc(const LadderMcConfig *cfg, int max_k, LadderSegment *out);
+
+#endif /* RESISTORCAL_LADDER_H */
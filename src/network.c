@@ -0,0 +1,815 @@
+/*
+ * network.c - Series/parallel resistor network engine
+ *
+ * Builds all possible series/parallel networks level by level
+ * (level n combines level i with level n-i) and analyses the
+ * resulting network trees.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "network.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+/* ========================================================================
+ * ENUMERATION
+ * ======================================================================== */
+
+/*
+ * Store the combination of networks A = (ln, li) and B = (rn, ri) in
+ * slot k of level n. Caller checks that k is within the level.
+ */
+static void fill_combination(NetworkSet *set, int n, int k, int op,
+                             int ln, int li, int rn, int ri)
+{
+    const Network *A = &set->level[ln][li];
+    const Network *B = &set->level[rn][ri];
+    Network *net = &set->level[n][k];
+    char expr[MAX_EXPR];
+    int p;
+
+    if (op == NET_SERIES) {
+        /* Series: R = A + B */
+        net->R = A->R + B->R;
+        net->R_lo = A->R_lo + B->R_lo;
+        net->R_hi = A->R_hi + B->R_hi;
+        net->tcr = (A->R * A->tcr + B->R * B->tcr) / net->R;
+        net->stress = fmax(A->stress, B->stress);
+        snprintf(expr, MAX_EXPR, "(%s + %s)", A->expr, B->expr);
+    } else {
+        /* Parallel: R = 1/(1/A + 1/B) - use Unicode ∥ symbol */
+        net->R = 1.0 / ((1.0 / A->R) + (1.0 / B->R));
+        net->R_lo = 1.0 / ((1.0 / A->R_lo) + (1.0 / B->R_lo));
+        net->R_hi = 1.0 / ((1.0 / A->R_hi) + (1.0 / B->R_hi));
+        net->tcr = (B->R * A->tcr + A->R * B->tcr) / (A->R + B->R);
+        {
+            double ka = B->R / (A->R + B->R);   /* share of the current in A */
+            double kb = A->R / (A->R + B->R);
+            net->stress = fmax(A->stress * ka * ka, B->stress * kb * kb);
+        }
+        snprintf(expr, MAX_EXPR, "(%s ∥ %s)", A->expr, B->expr);
+    }
+    net->n = A->n + B->n;
+    strncpy(net->expr, expr, MAX_EXPR - 1);
+    net->expr[MAX_EXPR - 1] = '\0';
+
+    /* Copy parts from both networks */
+    net->num_parts = 0;
+    for (p = 0; p < A->num_parts && net->num_parts < MAX_RESISTORS_PER_NET; p++)
+        net->parts[net->num_parts++] = A->parts[p];
+    for (p = 0; p < B->num_parts && net->num_parts < MAX_RESISTORS_PER_NET; p++)
+        net->parts[net->num_parts++] = B->parts[p];
+
+    net->op = op;
+    net->left_n = ln;
+    net->left_i = li;
+    net->right_n = rn;
+    net->right_i = ri;
+}
+
+/*
+ * A level is built in rows: row r combines network row_a[r] of level
+ * row_i[r] with every eligible network of the complementary level. Each
+ * row's output size is known up front (one series network per pair,
+ * plus a parallel one when both R > 0), so a prefix sum gives every row
+ * its first slot and rows fill their slots independently. The result is
+ * the same as appending serially, whatever the thread count.
+ */
+#define LEVEL_ROWS_PER_ITEM 16
+
+typedef struct {
+    NetworkSet *set;
+    int n;
+    int rows;
+    const int *row_i, *row_a;
+    const int *row_start;          /* first slot of each row */
+} LevelJob;
+
+static void level_worker(int item, void *ctx)
+{
+    const LevelJob *job = (const LevelJob *)ctx;
+    NetworkSet *set = job->set;
+    int r = item * LEVEL_ROWS_PER_ITEM;
+    int last = r + LEVEL_ROWS_PER_ITEM;
+
+    if (last > job->rows)
+        last = job->rows;
+
+    for (; r < last; r++) {
+        int i = job->row_i[r], a = job->row_a[r], j = job->n - i;
+        int k = job->row_start[r], b;
+        double ra = set->level[i][a].R;
+
+        for (b = (i == j) ? a : 0; b < set->count[j] && k < MAX_NETWORKS; b++) {
+            fill_combination(set, job->n, k++, NET_SERIES, i, a, j, b);
+            if (ra > 0 && set->level[j][b].R > 0 && k < MAX_NETWORKS)
+                fill_combination(set, job->n, k++, NET_PARALLEL, i, a, j, b);
+        }
+    }
+}
+
+int network_set_begin(NetworkSet *set, const Part *available, int num_avail)
+{
+    int i;
+
+    memset(set, 0, sizeof(*set));
+
+    for (i = 1; i <= MAX_N; i++) {
+        set->level[i] = malloc(MAX_NETWORKS * sizeof(Network));
+        if (!set->level[i]) {
+            network_set_free(set);
+            return -1;
+        }
+    }
+
+    /* Base case: single resistor networks */
+    for (i = 0; i < num_avail && set->count[1] < MAX_NETWORKS; i++) {
+        Network *net = &set->level[1][set->count[1]];
+        net->R = available[i].R;
+        net->R_lo = available[i].R * (1.0 - available[i].tol);
+        net->R_hi = available[i].R * (1.0 + available[i].tol);
+        net->tcr = available[i].tcr;
+        /* P = I^2 R at 1 A; an unrated part never limits */
+        net->stress = available[i].power > 0 ? available[i].R / available[i].power : 0;
+        net->n = 1;
+        snprintf(net->expr, MAX_EXPR, "%.2f", available[i].R);
+        /* Track individual resistor value */
+        net->parts[0] = available[i].R;
+        net->num_parts = 1;
+        net->op = NET_LEAF;
+        net->left_n = net->left_i = net->right_n = net->right_i = -1;
+        set->count[1]++;
+    }
+    if (num_avail > MAX_NETWORKS)
+        set->truncated = 1;
+    return 0;
+}
+
+int network_set_build_level(NetworkSet *set, int n)
+{
+    LevelJob job;
+    int *row_i, *row_a, *row_start, *positive[MAX_N + 1] = { NULL };
+    int i, a, b, j_idx, rows = 0, max_rows = 0, ret = -1;
+    long slot = 0;
+
+    for (i = 1; i < n; i++)
+        max_rows += set->count[i];
+    row_i = malloc((max_rows + 1) * sizeof(int));
+    row_a = malloc((max_rows + 1) * sizeof(int));
+    row_start = malloc((max_rows + 1) * sizeof(int));
+    if (!row_i || !row_a || !row_start)
+        goto out;
+
+    /* positive[j][b]: networks of level j from b on with R > 0 */
+    for (j_idx = 1; j_idx < n; j_idx++) {
+        positive[j_idx] = malloc((set->count[j_idx] + 1) * sizeof(int));
+        if (!positive[j_idx])
+            goto out;
+        positive[j_idx][set->count[j_idx]] = 0;
+        for (b = set->count[j_idx] - 1; b >= 0; b--)
+            positive[j_idx][b] = positive[j_idx][b + 1] + (set->level[j_idx][b].R > 0);
+    }
+
+    /* Rows past MAX_NETWORKS are only counted, to tell if the level is cut */
+    for (i = 1; i < n; i++) {
+        j_idx = n - i;
+        /*
+         * Avoid duplicates by only combining when i <= j_idx
+         * For i == j_idx, only combine when a <= b
+         */
+        for (a = 0; a < set->count[i]; a++) {
+            int b_start = (i == j_idx) ? a : 0;
+            if (b_start >= set->count[j_idx])
+                continue;
+            if (slot < MAX_NETWORKS) {
+                row_i[rows] = i;
+                row_a[rows] = a;
+                row_start[rows] = (int)slot;
+                rows++;
+            }
+            slot += set->count[j_idx] - b_start;
+            if (set->level[i][a].R > 0)
+                slot += positive[j_idx][b_start];
+        }
+    }
+
+    job.set = set;
+    job.n = n;
+    job.rows = rows;
+    job.row_i = row_i;
+    job.row_a = row_a;
+    job.row_start = row_start;
+    parallel_for((rows + LEVEL_ROWS_PER_ITEM - 1) / LEVEL_ROWS_PER_ITEM, level_worker, &job);
+
+    set->count[n] = slot < MAX_NETWORKS ? (int)slot : MAX_NETWORKS;
+    if (slot > MAX_NETWORKS)
+        set->truncated = 1;
+    ret = 0;
+
+out:
+    for (j_idx = 1; j_idx < n; j_idx++)
+        free(positive[j_idx]);
+    free(row_i);
+    free(row_a);
+    free(row_start);
+    return ret;
+}
+
+int network_set_build(NetworkSet *set, const Part *available, int num_avail)
+{
+    int n;
+
+    if (network_set_begin(set, available, num_avail) != 0)
+        return -1;
+
+    /* Build networks with 2..MAX_N resistors */
+    for (n = 2; n <= MAX_N; n++) {
+        if (network_set_build_level(set, n) != 0) {
+            network_set_free(set);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void network_set_free(NetworkSet *set)
+{
+    int i;
+    for (i = 0; i <= MAX_N; i++) {
+        free(set->level[i]);  /* free(NULL) is safe */
+        set->level[i] = NULL;
+        set->count[i] = 0;
+    }
+}
+
+/* ========================================================================
+ * RESULT COLLECTION
+ * ======================================================================== */
+
+/* Comparison function for qsort - sort by error ascending */
+int compare_results(const void *a, const void *b)
+{
+    const Result *ra = (const Result *)a;
+    const Result *rb = (const Result *)b;
+    if (ra->error < rb->error) return -1;
+    if (ra->error > rb->error) return 1;
+    /* Secondary sort: fewer resistors first */
+    return ra->n - rb->n;
+}
+
+/* Comparison function for qsort - sort by Monte Carlo yield descending */
+int compare_results_yield(const void *a, const void *b)
+{
+    const Result *ra = (const Result *)a;
+    const Result *rb = (const Result *)b;
+    if (ra->yield > rb->yield) return -1;
+    if (ra->yield < rb->yield) return 1;
+    return compare_results(a, b);
+}
+
+/* Comparison function for qsort - sort by temperature drift ascending */
+int compare_results_tcr(const void *a, const void *b)
+{
+    const Result *ra = (const Result *)a;
+    const Result *rb = (const Result *)b;
+    if (fabs(ra->tcr) < fabs(rb->tcr)) return -1;
+    if (fabs(ra->tcr) > fabs(rb->tcr)) return 1;
+    return compare_results(a, b);
+}
+
+double network_load(const Network *net, const SearchSpec *spec)
+{
+    double current;
+
+    switch (spec->op_mode) {
+    case OPERATING_VOLTAGE:
+        current = spec->op_value / net->R;
+        break;
+    case OPERATING_CURRENT:
+        current = spec->op_value;
+        break;
+    default:
+        return 0;
+    }
+    return net->stress * current * current;
+}
+
+int network_matches(const Network *net, const SearchSpec *spec)
+{
+    double relError = fabs(net->R - spec->target) / spec->target;
+
+    if (relError > spec->tol)
+        return 0;
+    /* Worst case must stay inside the window, not just the nominal value */
+    if (spec->guaranteed &&
+        (net->R_lo < spec->target * (1.0 - spec->tol) ||
+         net->R_hi > spec->target * (1.0 + spec->tol)))
+        return 0;
+    if (spec->prune_overload && network_load(net, spec) > 1.0)
+        return 0;
+    return 1;
+}
+
+int network_collect(const NetworkSet *set, const SearchSpec *spec,
+                    Result *results, int max_results)
+{
+    int n, i, p;
+    int num_results = 0;
+
+    for (n = 1; n <= MAX_N; n++) {
+        for (i = 0; i < set->count[n] && num_results < max_results; i++) {
+            const Network *net = &set->level[n][i];
+            if (network_matches(net, spec)) {
+                Result *res = &results[num_results];
+                res->R = net->R;
+                res->R_lo = net->R_lo;
+                res->R_hi = net->R_hi;
+                res->tcr = net->tcr;
+                res->load = network_load(net, spec);
+                res->error = fabs(net->R - spec->target) / spec->target;
+                res->n = net->n;
+                strncpy(res->expr, net->expr, MAX_EXPR - 1);
+                res->expr[MAX_EXPR - 1] = '\0';
+                /* Copy individual parts */
+                res->num_parts = net->num_parts;
+                for (p = 0; p < net->num_parts; p++)
+                    res->parts[p] = net->parts[p];
+                res->level = n;
+                res->index = i;
+                res->yield = 0;
+                res->mc_mean = net->R;
+                res->mc_sigma = 0;
+                num_results++;
+            }
+        }
+    }
+
+    /* Sort results by error (ascending) */
+    if (num_results > 0)
+        qsort(results, num_results, sizeof(Result), compare_results);
+    return num_results;
+}
+
+/* ========================================================================
+ * POWER DISSIPATION
+ * ======================================================================== */
+
+static void part_power_node(const NetworkSet *set, int n, int i, double current,
+                            double *power, double *load, int *k)
+{
+    const Network *net = &set->level[n][i];
+    const Network *A, *B;
+
+    if (net->op == NET_LEAF) {
+        power[*k] = current * current * net->R;
+        load[*k] = current * current * net->stress;
+        (*k)++;
+        return;
+    }
+    A = &set->level[net->left_n][net->left_i];
+    B = &set->level[net->right_n][net->right_i];
+    if (net->op == NET_SERIES) {
+        part_power_node(set, net->left_n, net->left_i, current, power, load, k);
+        part_power_node(set, net->right_n, net->right_i, current, power, load, k);
+    } else {
+        part_power_node(set, net->left_n, net->left_i,
+                        current * B->R / (A->R + B->R), power, load, k);
+        part_power_node(set, net->right_n, net->right_i,
+                        current * A->R / (A->R + B->R), power, load, k);
+    }
+}
+
+void network_part_power(const NetworkSet *set, int n, int i, double current,
+                        double *power, double *load)
+{
+    int k = 0;
+    part_power_node(set, n, i, current, power, load, &k);
+}
+
+/* ========================================================================
+ * VOLTAGE DIVIDER SEARCH
+ * ======================================================================== */
+
+static int compare_refs(const void *a, const void *b)
+{
+    const NetRef *ra = (const NetRef *)a;
+    const NetRef *rb = (const NetRef *)b;
+    if (ra->R < rb->R) return -1;
+    if (ra->R > rb->R) return 1;
+    /* Secondary sort: fewer resistors first */
+    return ra->n - rb->n;
+}
+
+int network_sorted_refs(const NetworkSet *set, NetRef **refs)
+{
+    int n, i, total = 0, k = 0;
+
+    for (n = 1; n <= MAX_N; n++)
+        total += set->count[n];
+    *refs = malloc((total > 0 ? total : 1) * sizeof(NetRef));
+    if (!*refs)
+        return -1;
+    for (n = 1; n <= MAX_N; n++) {
+        for (i = 0; i < set->count[n]; i++) {
+            (*refs)[k].R = set->level[n][i].R;
+            (*refs)[k].n = n;
+            (*refs)[k].i = i;
+            k++;
+        }
+    }
+    qsort(*refs, total, sizeof(NetRef), compare_refs);
+    return total;
+}
+
+/* Comparison function for qsort - sort divider pairs by error, then parts */
+static int compare_dividers(const void *a, const void *b)
+{
+    const DividerResult *da = (const DividerResult *)a;
+    const DividerResult *db = (const DividerResult *)b;
+    if (da->error < db->error) return -1;
+    if (da->error > db->error) return 1;
+    return da->n - db->n;
+}
+
+/* Bounded max-heap on compare_dividers: the worst kept pair sits at [0] */
+static void divider_heap_push(DividerResult *heap, int *size, int cap,
+                              const DividerResult *cand)
+{
+    int i, parent, child;
+
+    if (*size < cap) {
+        i = (*size)++;
+        while (i > 0) {
+            parent = (i - 1) / 2;
+            if (compare_dividers(&heap[parent], cand) >= 0)
+                break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = *cand;
+        return;
+    }
+    if (compare_dividers(cand, &heap[0]) >= 0)
+        return;
+    /* Replace the root and sift down */
+    i = 0;
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= *size)
+            break;
+        if (child + 1 < *size && compare_dividers(&heap[child + 1], &heap[child]) > 0)
+            child++;
+        if (compare_dividers(&heap[child], cand) <= 0)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = *cand;
+}
+
+int divider_search_refs(const NetRef *refs, int count, const DividerSpec *spec,
+                        DividerResult *results, int max_results)
+{
+    int b, lo = 0, hi = 0, t;
+    int num_results = 0;
+    const double k_lo = spec->ratio * (1.0 - spec->tol);
+    const double k_hi = fmin(spec->ratio * (1.0 + spec->tol), 1.0);
+
+    if (spec->ratio <= 0 || spec->ratio >= 1 || max_results <= 0)
+        return 0;
+
+    for (b = 0; b < count; b++) {
+        const NetRef *bot = &refs[b];
+        /* Rtop = Rbot (1 - k) / k, decreasing in k */
+        const double top_min = bot->R * (1.0 - k_hi) / k_hi;
+        const double top_max = bot->R * (1.0 - k_lo) / k_lo;
+
+        while (lo < count && refs[lo].R < top_min)
+            lo++;
+        if (hi < lo)
+            hi = lo;
+        while (hi < count && refs[hi].R <= top_max)
+            hi++;
+
+        for (t = lo; t < hi; t++) {
+            const NetRef *top = &refs[t];
+            DividerResult cand;
+
+            cand.n = top->n + bot->n;
+            if (spec->max_parts > 0 && cand.n > spec->max_parts)
+                continue;
+            cand.total = top->R + bot->R;
+            if (spec->min_total > 0 && cand.total < spec->min_total)
+                continue;
+            if (spec->max_total > 0 && cand.total > spec->max_total)
+                continue;
+            cand.zout = top->R * bot->R / cand.total;
+            if (spec->max_zout > 0 && cand.zout > spec->max_zout)
+                continue;
+            cand.ratio = bot->R / cand.total;
+            cand.error = fabs(cand.ratio - spec->ratio) / spec->ratio;
+            if (cand.error > spec->tol)
+                continue;
+            cand.top_n = top->n;
+            cand.top_i = top->i;
+            cand.bot_n = bot->n;
+            cand.bot_i = bot->i;
+            cand.Rtop = top->R;
+            cand.Rbot = bot->R;
+            divider_heap_push(results, &num_results, max_results, &cand);
+        }
+    }
+
+    qsort(results, num_results, sizeof(DividerResult), compare_dividers);
+    return num_results;
+}
+
+int divider_search(const NetworkSet *set, const DividerSpec *spec,
+                   DividerResult *results, int max_results)
+{
+    NetRef *refs;
+    int count, num_results;
+
+    if (spec->ratio <= 0 || spec->ratio >= 1 || max_results <= 0)
+        return 0;
+    count = network_sorted_refs(set, &refs);
+    if (count < 0)
+        return -1;
+    num_results = divider_search_refs(refs, count, spec, results, max_results);
+    free(refs);
+    return num_results;
+}
+
+/* ========================================================================
+ * NETWORK PROGRAMS
+ * ======================================================================== */
+
+static void compile_node(const NetworkSet *set, int n, int i, NetProgram *prog)
+{
+    const Network *net = &set->level[n][i];
+
+    if (net->op == NET_LEAF) {
+        prog->op[prog->num_ops++] = NET_LEAF;
+        prog->leaf[prog->num_leaves] = net->R;
+        /* leaf bounds are exactly R(1±tol) */
+        prog->leaf_tol[prog->num_leaves] = (net->R_hi - net->R) / net->R;
+        prog->num_leaves++;
+        return;
+    }
+    compile_node(set, net->left_n, net->left_i, prog);
+    compile_node(set, net->right_n, net->right_i, prog);
+    prog->op[prog->num_ops++] = (unsigned char)net->op;
+}
+
+void network_compile(const NetworkSet *set, int n, int i, NetProgram *prog)
+{
+    prog->num_ops = 0;
+    prog->num_leaves = 0;
+    compile_node(set, n, i, prog);
+}
+
+double network_eval(const NetProgram *prog)
+{
+    double stack[MAX_RESISTORS_PER_NET];
+    int k, sp = 0, leaf = 0;
+
+    for (k = 0; k < prog->num_ops; k++) {
+        switch (prog->op[k]) {
+        case NET_LEAF:
+            stack[sp++] = prog->leaf[leaf++];
+            break;
+        case NET_SERIES:
+            sp--;
+            stack[sp - 1] += stack[sp];
+            break;
+        default:
+            sp--;
+            stack[sp - 1] = stack[sp - 1] * stack[sp] / (stack[sp - 1] + stack[sp]);
+            break;
+        }
+    }
+    return stack[0];
+}
+
+/* ========================================================================
+ * MONTE CARLO YIELD
+ * ======================================================================== */
+
+/*
+ * Trials run in blocks of MC_LANES independent samples. Every inner loop
+ * below walks one block, so the compiler can vectorize it; each lane has
+ * its own xoshiro256+ generator.
+ *
+ * A part value is R * (1 + t/3 * (u1 + u2 + u3)) with u in [-1, 1]:
+ * near-Gaussian with sigma = t/3 and hard-limited to ±t, matching how
+ * part tolerance is usually specified. The three uniforms are 21-bit
+ * slices of a single 64-bit draw.
+ */
+#define MC_LANES 256
+#define MC_CHUNK (64 * 1024)   /* trials per work item */
+#define MC_SLICE_BITS 21
+#define MC_SLICE_MASK ((1u << MC_SLICE_BITS) - 1)
+
+typedef struct {
+    uint64_t s[4][MC_LANES];
+} LaneRng;
+
+typedef struct {
+    long in_spec;
+    double sum;                    /* sum of (R - nominal) */
+    double sum_sq;                 /* sum of (R - nominal)^2 */
+    long trials;
+} McPartial;
+
+typedef struct {
+    const NetProgram *progs;
+    const McConfig *cfg;
+    int chunks;                    /* work items per network */
+    McPartial *partials;
+} McJob;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void lane_rng_seed(LaneRng *rng, uint64_t seed)
+{
+    int k, l;
+    for (l = 0; l < MC_LANES; l++)
+        for (k = 0; k < 4; k++)
+            rng->s[k][l] = splitmix64(&seed);
+}
+
+static void lane_rng_next(LaneRng *rng, uint64_t *out)
+{
+    int l;
+    for (l = 0; l < MC_LANES; l++) {
+        uint64_t s0 = rng->s[0][l], s1 = rng->s[1][l];
+        uint64_t s2 = rng->s[2][l], s3 = rng->s[3][l];
+        uint64_t t = s1 << 17;
+
+        out[l] = s0 + s3;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = (s3 << 45) | (s3 >> 19);
+
+        rng->s[0][l] = s0;
+        rng->s[1][l] = s1;
+        rng->s[2][l] = s2;
+        rng->s[3][l] = s3;
+    }
+}
+
+/* Fill dst with MC_LANES samples of a part with nominal value R */
+static void sample_part(LaneRng *rng, double R, double part_tol, double *dst)
+{
+    uint64_t bits[MC_LANES];
+    /* sum of three slices in [0, 3*mask] maps linearly onto [R(1-t), R(1+t)] */
+    const double scale = R * part_tol * 2.0 / (3.0 * MC_SLICE_MASK);
+    const double base = R * (1.0 - part_tol);
+    int l;
+
+    lane_rng_next(rng, bits);
+    for (l = 0; l < MC_LANES; l++) {
+        uint32_t sum = (uint32_t)(bits[l] & MC_SLICE_MASK) +
+                       (uint32_t)((bits[l] >> MC_SLICE_BITS) & MC_SLICE_MASK) +
+                       (uint32_t)((bits[l] >> (2 * MC_SLICE_BITS)) & MC_SLICE_MASK);
+        dst[l] = base + scale * (double)(int32_t)sum;
+    }
+}
+
+static void mc_worker(int item, void *ctx)
+{
+    McJob *job = (McJob *)ctx;
+    const McConfig *cfg = job->cfg;
+    int net_idx = item / job->chunks;
+    int chunk = item % job->chunks;
+    const NetProgram *prog = &job->progs[net_idx];
+    McPartial *out = &job->partials[item];
+    double stack[MAX_RESISTORS_PER_NET][MC_LANES];
+    const double nominal = network_eval(prog);
+    const double lo = cfg->target * (1.0 - cfg->tol);
+    const double hi = cfg->target * (1.0 + cfg->tol);
+    long first = (long)chunk * MC_CHUNK;
+    long todo = cfg->trials - first;
+    LaneRng *rng;
+    uint64_t seed;
+
+    memset(out, 0, sizeof(*out));
+    if (todo > MC_CHUNK) todo = MC_CHUNK;
+    if (todo <= 0)
+        return;
+
+    rng = malloc(sizeof(LaneRng));
+    if (!rng)
+        return;
+    seed = (uint64_t)cfg->seed ^ ((uint64_t)net_idx << 32) ^ (uint64_t)chunk;
+    lane_rng_seed(rng, seed);
+
+    while (todo > 0) {
+        int lanes = todo < MC_LANES ? (int)todo : MC_LANES;
+        int k, l, sp = 0, leaf = 0;
+        long in_spec = 0;
+        double sum = 0, sum_sq = 0;
+
+        for (k = 0; k < prog->num_ops; k++) {
+            double *x, *y;
+            switch (prog->op[k]) {
+            case NET_LEAF:
+                sample_part(rng, prog->leaf[leaf], prog->leaf_tol[leaf], stack[sp++]);
+                leaf++;
+                break;
+            case NET_SERIES:
+                sp--;
+                x = stack[sp - 1];
+                y = stack[sp];
+                for (l = 0; l < MC_LANES; l++)
+                    x[l] += y[l];
+                break;
+            default:
+                sp--;
+                x = stack[sp - 1];
+                y = stack[sp];
+                for (l = 0; l < MC_LANES; l++)
+                    x[l] = x[l] * y[l] / (x[l] + y[l]);
+                break;
+            }
+        }
+
+        for (l = 0; l < lanes; l++) {
+            double r = stack[0][l];
+            double d = r - nominal;
+            in_spec += (r >= lo) & (r <= hi);
+            sum += d;
+            sum_sq += d * d;
+        }
+        out->in_spec += in_spec;
+        out->sum += sum;
+        out->sum_sq += sum_sq;
+        out->trials += lanes;
+        todo -= lanes;
+    }
+    free(rng);
+}
+
+void network_monte_carlo(const NetworkSet *set, Result *results, int num_results,
+                         const McConfig *cfg)
+{
+    McJob job;
+    NetProgram *progs;
+    int i, c;
+
+    if (num_results <= 0 || cfg->trials <= 0)
+        return;
+
+    progs = malloc(num_results * sizeof(NetProgram));
+    job.chunks = (int)((cfg->trials + MC_CHUNK - 1) / MC_CHUNK);
+    job.partials = malloc((size_t)num_results * job.chunks * sizeof(McPartial));
+    if (!progs || !job.partials) {
+        free(progs);
+        free(job.partials);
+        return;
+    }
+    for (i = 0; i < num_results; i++)
+        network_compile(set, results[i].level, results[i].index, &progs[i]);
+    job.progs = progs;
+    job.cfg = cfg;
+
+    parallel_for(num_results * job.chunks, mc_worker, &job);
+
+    for (i = 0; i < num_results; i++) {
+        const double nominal = network_eval(&progs[i]);
+        McPartial total = {0, 0, 0, 0};
+        double mean_d;
+
+        for (c = 0; c < job.chunks; c++) {
+            const McPartial *p = &job.partials[i * job.chunks + c];
+            total.in_spec += p->in_spec;
+            total.sum += p->sum;
+            total.sum_sq += p->sum_sq;
+            total.trials += p->trials;
+        }
+        if (total.trials == 0)
+            continue;
+        mean_d = total.sum / total.trials;
+        results[i].yield = (double)total.in_spec / total.trials;
+        results[i].mc_mean = nominal + mean_d;
+        results[i].mc_sigma = sqrt(fmax(0.0, total.sum_sq / total.trials - mean_d * mean_d));
+    }
+
+    free(progs);
+    free(job.partials);
+}
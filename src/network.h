@@ -0,0 +1,226 @@
+/*
+ * network.h - Series/parallel resistor network engine
+ *
+ * Enumerates series/parallel combinations of the available resistor
+ * values and analyses them. GTK-free so it can be reused outside the
+ * desktop UI.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RESISTORCAL_NETWORK_H
+#define RESISTORCAL_NETWORK_H
+
+#define MAX_N 5           /* maximum resistors in a network */
+#define MAX_NETWORKS 10000
+#define MAX_EXPR 256
+
+#define MAX_RESISTORS_PER_NET 8  /* max individual resistors tracked */
+
+/* Node types of the network tree */
+enum {
+    NET_LEAF = 0,     /* single resistor */
+    NET_SERIES,       /* R = A + B */
+    NET_PARALLEL      /* R = A ∥ B */
+};
+
+/* An available part */
+typedef struct {
+    double R;                      /* nominal value (ohms) */
+    double tol;                    /* tolerance, relative (e.g. 0.05) */
+    double tcr;                    /* temperature coefficient (ppm/°C) */
+    double power;                  /* rated power (W) */
+} Part;
+
+typedef struct {
+    double R;                      /* equivalent resistance (ohms) */
+    double R_lo, R_hi;             /* worst-case bounds from part tolerances */
+    double tcr;                    /* effective temperature coefficient (ppm/°C) */
+    double stress;                 /* max part P/Prated with 1 A through the network */
+    int n;                         /* number of resistors used */
+    char expr[MAX_EXPR];           /* text expression of the network */
+    double parts[MAX_RESISTORS_PER_NET]; /* individual resistor values */
+    int num_parts;                 /* count of parts */
+    int op;                        /* NET_LEAF, NET_SERIES or NET_PARALLEL */
+    int left_n, left_i;            /* left operand (level, index) */
+    int right_n, right_i;          /* right operand (level, index) */
+} Network;
+
+/* All enumerated networks, grouped by resistor count */
+typedef struct {
+    Network *level[MAX_N + 1];     /* level[n] holds networks of n resistors */
+    int count[MAX_N + 1];
+    int truncated;                 /* a level had more than MAX_NETWORKS networks */
+} NetworkSet;
+
+typedef struct {
+    double R;                      /* equivalent resistance */
+    double R_lo, R_hi;             /* worst-case bounds */
+    double tcr;                    /* effective TCR (ppm/°C) */
+    double load;                   /* worst part P/Prated at the operating point */
+    double error;                  /* relative error (0-1) */
+    int n;                         /* number of resistors */
+    char expr[MAX_EXPR];           /* expression */
+    double parts[MAX_RESISTORS_PER_NET]; /* individual resistor values */
+    int num_parts;                 /* count of parts */
+    int level, index;              /* source network in the NetworkSet */
+    double yield;                  /* Monte Carlo: fraction within spec (0-1) */
+    double mc_mean;                /* Monte Carlo: mean equivalent R */
+    double mc_sigma;               /* Monte Carlo: std deviation of R */
+} Result;
+
+/*
+ * Postfix program for one network: leaves are pushed in the same order
+ * as Network.parts, series/parallel ops pop two values and push one.
+ */
+typedef struct {
+    int num_ops;
+    unsigned char op[2 * MAX_RESISTORS_PER_NET];
+    int num_leaves;
+    double leaf[MAX_RESISTORS_PER_NET];
+    double leaf_tol[MAX_RESISTORS_PER_NET];
+} NetProgram;
+
+/* Operating point applied to a network */
+enum {
+    OPERATING_NONE = 0,
+    OPERATING_VOLTAGE,             /* op_value volts across the network */
+    OPERATING_CURRENT              /* op_value amps through the network */
+};
+
+/* What to look for in a NetworkSet */
+typedef struct {
+    double target;                 /* target resistance (ohms) */
+    double tol;                    /* allowed error, relative (e.g. 0.02) */
+    int guaranteed;                /* require the worst-case interval in spec */
+    int op_mode;                   /* OPERATING_* */
+    double op_value;
+    int prune_overload;            /* drop networks with an overloaded part */
+} SearchSpec;
+
+/* Reference to one network of a set, used for sorted indexes */
+typedef struct {
+    double R;
+    int n, i;                      /* level and index */
+} NetRef;
+
+/* Voltage divider search: ratio = Vout/Vin = Rbot / (Rtop + Rbot) */
+typedef struct {
+    double ratio;                  /* target ratio (0-1) */
+    double tol;                    /* allowed ratio error, relative */
+    double min_total, max_total;   /* Rtop + Rbot limits (0 = none) */
+    double max_zout;               /* Rtop ∥ Rbot limit (0 = none) */
+    int max_parts;                 /* parts in both networks (0 = none) */
+} DividerSpec;
+
+typedef struct {
+    int top_n, top_i;              /* top network (level, index) */
+    int bot_n, bot_i;              /* bottom network (level, index) */
+    double Rtop, Rbot;
+    double ratio;                  /* achieved ratio */
+    double error;                  /* relative ratio error */
+    double total;                  /* Rtop + Rbot */
+    double zout;                   /* Rtop ∥ Rbot */
+    int n;                         /* total parts */
+} DividerResult;
+
+/* Monte Carlo yield analysis settings (part tolerance is taken as 3 sigma) */
+typedef struct {
+    double target;                 /* target resistance (ohms) */
+    double tol;                    /* spec window, relative (e.g. 0.02) */
+    long trials;                   /* samples per network */
+    unsigned long seed;
+} McConfig;
+
+/*
+ * Build all series/parallel networks of 1..MAX_N resistors.
+ * Worst-case bounds are propagated alongside the nominal value: each
+ * leaf is [R(1-t), R(1+t)]; series adds the bounds and parallel combines
+ * them as conductances. Both operations are monotone in every operand
+ * and each part appears once in the tree, so the bounds are exact.
+ * The effective TCR is the sensitivity-weighted sum of part TCRs:
+ * series weights each side by A/R and B/R, parallel by R/A and R/B.
+ * Power stress is the worst part P/Prated at 1 A: series passes the
+ * current to both sides, parallel splits it as B/(A+B) and A/(A+B).
+ * Returns 0 on success, -1 on allocation failure (set is freed).
+ */
+int network_set_build(NetworkSet *set, const Part *available, int num_avail);
+
+/*
+ * The same build one level at a time, for callers that report results
+ * as levels complete: network_set_begin allocates the set and fills
+ * level 1, network_set_build_level(n) fills level n from the levels
+ * below it. Every row of combinations gets its output slots from a
+ * prefix sum, so rows are built in parallel and the level comes out in
+ * the serial order. Unbuilt levels are empty. A level keeps its first
+ * MAX_NETWORKS networks and sets truncated if there were more. Both
+ * return 0, or -1 on allocation failure.
+ */
+int network_set_begin(NetworkSet *set, const Part *available, int num_avail);
+int network_set_build_level(NetworkSet *set, int n);
+void network_set_free(NetworkSet *set);
+
+/*
+ * Copy networks matching spec into results (at most max_results) and
+ * sort them by error. Returns the number of results.
+ */
+int network_collect(const NetworkSet *set, const SearchSpec *spec,
+                    Result *results, int max_results);
+
+/* Does the network satisfy spec? */
+int network_matches(const Network *net, const SearchSpec *spec);
+
+/*
+ * Worst part P/Prated at the spec's operating point (0 without one).
+ * Above 1.0 means at least one part exceeds its rating.
+ */
+double network_load(const Network *net, const SearchSpec *spec);
+
+/*
+ * Per-part dissipation of network (n, i) with current amps through it,
+ * in one top-down traversal. power[] and load[] (P/Prated) are filled
+ * in the same order as Network.parts.
+ */
+void network_part_power(const NetworkSet *set, int n, int i, double current,
+                        double *power, double *load);
+
+/* qsort comparators for Result arrays */
+int compare_results(const void *a, const void *b);
+int compare_results_yield(const void *a, const void *b);
+int compare_results_tcr(const void *a, const void *b);
+
+/*
+ * All networks of the set sorted by R. Returns the count and stores a
+ * malloc'd array in *refs (caller frees), or -1 on allocation failure.
+ */
+int network_sorted_refs(const NetworkSet *set, NetRef **refs);
+
+/*
+ * Find (top, bottom) network pairs hitting spec->ratio. For bottoms in
+ * ascending R the acceptable top window ascends too, so both window
+ * edges advance monotonically over the sorted index (two-pointer join).
+ * Keeps the max_results best pairs by error, then part count.
+ * Returns the number of results (sorted), or -1 on allocation failure.
+ */
+int divider_search(const NetworkSet *set, const DividerSpec *spec,
+                   DividerResult *results, int max_results);
+
+/* The same over an index from network_sorted_refs, for callers that keep one */
+int divider_search_refs(const NetRef *refs, int count, const DividerSpec *spec,
+                        DividerResult *results, int max_results);
+
+/* Flatten network (n, i) of the set into a postfix program */
+void network_compile(const NetworkSet *set, int n, int i, NetProgram *prog);
+
+/* Evaluate a program with its nominal leaf values */
+double network_eval(const NetProgram *prog);
+
+/*
+ * Monte Carlo yield: sample every part of each result's network within
+ * its tolerance and fill yield, mc_mean and mc_sigma. Runs multi-threaded;
+ * results are deterministic for a given seed.
+ */
+void network_monte_carlo(const NetworkSet *set, Result *results, int num_results,
+                         const McConfig *cfg);
+
+#endif /* RESISTORCAL_NETWORK_H */
@@ -0,0 +1,244 @@
+/*
+ * parallel.c - Minimal portable parallel-for
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L   /* pthreads, sysconf() under -std=c99 */
+#endif
+
+#include "parallel.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#define PARALLEL_WIN32 1
+#elif defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define PARALLEL_SERIAL 1
+#else
+#include <pthread.h>
+#include <unistd.h>
+#define PARALLEL_PTHREADS 1
+#endif
+
+#define MAX_THREADS 64
+
+typedef struct {
+    ParallelFunc fn;
+    void *ctx;
+    int count;
+    int next;          /* next unclaimed item */
+#if defined(PARALLEL_WIN32)
+    CRITICAL_SECTION lock;
+#elif defined(PARALLEL_PTHREADS)
+    pthread_mutex_t lock;
+#endif
+} ParallelJob;
+
+int parallel_num_threads(void)
+{
+    static int cached = 0;
+    const char *env;
+    int n = 1;
+
+    if (cached > 0)
+        return cached;
+
+    env = getenv("RESISTORCAL_THREADS");
+    if (env && atoi(env) > 0) {
+        n = atoi(env);
+    } else {
+#if defined(PARALLEL_WIN32)
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        n = (int)si.dwNumberOfProcessors;
+#elif defined(PARALLEL_PTHREADS)
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n = online > 0 ? (int)online : 1;
+#endif
+    }
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    cached = n;
+    return n;
+}
+
+#if defined(PARALLEL_WIN32)
+
+static INIT_ONCE serial_once = INIT_ONCE_STATIC_INIT;
+static DWORD serial_key = TLS_OUT_OF_INDEXES;
+
+static BOOL CALLBACK serial_key_init(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void)once;
+    (void)param;
+    (void)context;
+    serial_key = TlsAlloc();
+    return TRUE;
+}
+
+void parallel_set_serial(int serial)
+{
+    InitOnceExecuteOnce(&serial_once, serial_key_init, NULL, NULL);
+    if (serial_key != TLS_OUT_OF_INDEXES)
+        TlsSetValue(serial_key, serial ? (LPVOID)1 : NULL);
+}
+
+static int thread_is_serial(void)
+{
+    InitOnceExecuteOnce(&serial_once, serial_key_init, NULL, NULL);
+    return serial_key != TLS_OUT_OF_INDEXES && TlsGetValue(serial_key) != NULL;
+}
+
+#elif defined(PARALLEL_PTHREADS)
+
+static pthread_once_t serial_once = PTHREAD_ONCE_INIT;
+static pthread_key_t serial_key;
+static int serial_key_ok = 0;
+
+static void serial_key_init(void)
+{
+    serial_key_ok = pthread_key_create(&serial_key, NULL) == 0;
+}
+
+void parallel_set_serial(int serial)
+{
+    pthread_once(&serial_once, serial_key_init);
+    if (serial_key_ok)
+        pthread_setspecific(serial_key, serial ? (void *)1 : NULL);
+}
+
+static int thread_is_serial(void)
+{
+    pthread_once(&serial_once, serial_key_init);
+    return serial_key_ok && pthread_getspecific(serial_key) != NULL;
+}
+
+#else
+
+void parallel_set_serial(int serial)
+{
+    (void)serial;
+}
+
+#endif
+
+#ifndef PARALLEL_SERIAL
+
+/* Claim the next item index, or -1 when the job is drained */
+static int claim_next(ParallelJob *job)
+{
+    int idx;
+#if defined(PARALLEL_WIN32)
+    EnterCriticalSection(&job->lock);
+#else
+    pthread_mutex_lock(&job->lock);
+#endif
+    idx = job->next < job->count ? job->next++ : -1;
+#if defined(PARALLEL_WIN32)
+    LeaveCriticalSection(&job->lock);
+#else
+    pthread_mutex_unlock(&job->lock);
+#endif
+    return idx;
+}
+
+static void run_items(ParallelJob *job)
+{
+    int idx;
+    while ((idx = claim_next(job)) >= 0)
+        job->fn(idx, job->ctx);
+}
+
+#if defined(PARALLEL_WIN32)
+static unsigned __stdcall worker_main(void *arg)
+{
+    run_items((ParallelJob *)arg);
+    return 0;
+}
+#else
+static void *worker_main(void *arg)
+{
+    run_items((ParallelJob *)arg);
+    return NULL;
+}
+#endif
+
+#endif /* !PARALLEL_SERIAL */
+
+void parallel_for(int count, ParallelFunc fn, void *ctx)
+{
+    int nthreads, i;
+
+    if (count <= 0)
+        return;
+
+    nthreads = parallel_num_threads();
+    if (nthreads > count)
+        nthreads = count;
+
+#ifdef PARALLEL_SERIAL
+    (void)nthreads;
+    for (i = 0; i < count; i++)
+        fn(i, ctx);
+#else
+    if (nthreads <= 1 || thread_is_serial()) {
+        for (i = 0; i < count; i++)
+            fn(i, ctx);
+        return;
+    }
+
+    {
+        ParallelJob job;
+        int started = 0;
+#if defined(PARALLEL_WIN32)
+        HANDLE threads[MAX_THREADS];
+#else
+        pthread_t threads[MAX_THREADS];
+#endif
+
+        job.fn = fn;
+        job.ctx = ctx;
+        job.count = count;
+        job.next = 0;
+#if defined(PARALLEL_WIN32)
+        InitializeCriticalSection(&job.lock);
+#else
+        pthread_mutex_init(&job.lock, NULL);
+#endif
+
+        /* The calling thread works too, so start nthreads - 1 helpers */
+        for (i = 0; i < nthreads - 1; i++) {
+#if defined(PARALLEL_WIN32)
+            threads[started] = (HANDLE)_beginthreadex(NULL, 0, worker_main, &job, 0, NULL);
+            if (threads[started] == 0)
+                break;
+#else
+            if (pthread_create(&threads[started], NULL, worker_main, &job) != 0)
+                break;
+#endif
+            started++;
+        }
+
+        run_items(&job);
+
+        for (i = 0; i < started; i++) {
+#if defined(PARALLEL_WIN32)
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+#else
+            pthread_join(threads[i], NULL);
+#endif
+        }
+
+#if defined(PARALLEL_WIN32)
+        DeleteCriticalSection(&job.lock);
+#else
+        pthread_mutex_destroy(&job.lock);
+#endif
+    }
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+ * parallel.h - Minimal portable parallel-for
+ *
+ * Runs independent work items on a small pool of threads (pthreads on
+ * POSIX, Win32 threads on Windows). Builds without thread support fall
+ * back to running the items serially.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RESISTORCAL_PARALLEL_H
+#define RESISTORCAL_PARALLEL_H
+
+/* Work item callback: index is in [0, count) */
+typedef void (*ParallelFunc)(int index, void *ctx);
+
+/*
+ * Number of worker threads used by parallel_for().
+ * Defaults to the number of online CPUs; the RESISTORCAL_THREADS
+ * environment variable overrides it.
+ */
+int parallel_num_threads(void);
+
+/*
+ * Make parallel_for() calls from the calling thread run serially (or
+ * again in parallel with 0). For threads that are already one of a pool,
+ * so nested calls do not start threads of their own.
+ */
+void parallel_set_serial(int serial);
+
+/*
+ * Call fn(i, ctx) for every i in [0, count), spread across worker
+ * threads. Items are claimed dynamically, so uneven items balance out.
+ * Returns when all items have completed.
+ */
+void parallel_for(int count, ParallelFunc fn, void *ctx);
+
+#endif /* RESISTORCAL_PARALLEL_H */
@@ -0,0 +1,701 @@
+/*
+ * python.c - CPython extension over the network and ladder engines
+ *
+ * `import resistorcal` gives design scripts the engines in-process:
+ * an Inventory keeps one network set and its sorted index, so each
+ * query is a search over warm data. Batch calls read any C-contiguous
+ * buffer (NumPy arrays, array.array, memoryview) in place and return a
+ * float64 memoryview that numpy.asarray() wraps without copying, or
+ * fill a caller's out= buffer. The GIL is released while the engines
+ * run. Built by CMakeLists.txt with -DRESISTORCAL_PYTHON=ON.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "network.h"
+#include "ladder.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BEST_FIELDS 4             /* R, relative error, parts, network id */
+#define R2R_FIELDS 6              /* INL max/min, DNL max/min, non-monotonic, gain error */
+
+/* ========================================================================
+ * BUFFERS
+ * ======================================================================== */
+
+/* Borrow obj as a flat C-contiguous vector of float64 or integers */
+static int get_vector(PyObject *obj, Py_buffer *view, const char *name)
+{
+    char kind;
+
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        return -1;
+    kind = view->format[0] == '<' || view->format[0] == '=' || view->format[0] == '@'
+               ? view->format[1] : view->format[0];
+    if (!((kind == 'd' && view->itemsize == 8) ||
+          (strchr("bhilq", kind) && view->itemsize <= 8) ||
+          (strchr("BHILQ", kind) && view->itemsize <= 8))) {
+        PyErr_Format(PyExc_TypeError, "%s must hold float64 or integer values", name);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+static double vector_at(const Py_buffer *view, Py_ssize_t i)
+{
+    const char *p = (const char *)view->buf + i * view->itemsize;
+    char kind = view->format[0] == '<' || view->format[0] == '=' || view->format[0] == '@'
+                    ? view->format[1] : view->format[0];
+
+    if (kind == 'd')
+        return *(const double *)p;
+    if (kind >= 'a') {
+        switch (view->itemsize) {
+        case 1: return *(const signed char *)p;
+        case 2: return *(const short *)p;
+        case 4: return *(const int *)p;
+        default: return (double)*(const long long *)p;
+        }
+    }
+    switch (view->itemsize) {
+    case 1: return *(const unsigned char *)p;
+    case 2: return *(const unsigned short *)p;
+    case 4: return *(const unsigned int *)p;
+    default: return (double)*(const unsigned long long *)p;
+    }
+}
+
+static Py_ssize_t vector_length(const Py_buffer *view)
+{
+    return view->len / view->itemsize;
+}
+
+/*
+ * Output of rows x cols float64: the caller's out buffer when given
+ * (writable, C-contiguous, exactly that size), else a new bytearray.
+ * *result gets the object to return; data points at its storage.
+ */
+static int get_output(PyObject *out, Py_ssize_t rows, int cols, Py_buffer *view,
+                      PyObject **result, double **data)
+{
+    PyObject *bytes, *mv;
+
+    if (out && out != Py_None) {
+        if (PyObject_GetBuffer(out, view, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE | PyBUF_FORMAT) != 0)
+            return -1;
+        if (view->itemsize != 8 || strchr(view->format, 'd') == NULL ||
+            view->len != rows * cols * (Py_ssize_t)sizeof(double)) {
+            PyErr_Format(PyExc_ValueError, "out must be a float64 buffer of %zd x %d", rows, cols);
+            PyBuffer_Release(view);
+            return -1;
+        }
+        Py_INCREF(out);
+        *result = out;
+        *data = (double *)view->buf;
+        return 0;
+    }
+
+    view->obj = NULL;
+    if (rows == 0) {
+        /* memoryview.cast() refuses zeros in the shape; describe it directly */
+        static double none[1];
+        static Py_ssize_t shape[R2R_FIELDS + 1][2], strides[R2R_FIELDS + 1][2];
+        Py_buffer empty;
+
+        shape[cols][0] = 0;
+        shape[cols][1] = cols;
+        strides[cols][0] = cols * (Py_ssize_t)sizeof(double);
+        strides[cols][1] = sizeof(double);
+        memset(&empty, 0, sizeof(empty));
+        empty.buf = none;
+        empty.itemsize = sizeof(double);
+        empty.format = "d";
+        empty.ndim = 2;
+        empty.shape = shape[cols];
+        empty.strides = strides[cols];
+        *data = none;
+        *result = PyMemoryView_FromBuffer(&empty);
+        return *result ? 0 : -1;
+    }
+    bytes = PyByteArray_FromStringAndSize(NULL, rows * cols * (Py_ssize_t)sizeof(double));
+    if (!bytes)
+        return -1;
+    *data = (double *)PyByteArray_AS_STRING(bytes);
+    mv = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);             /* the view keeps it alive */
+    if (!mv)
+        return -1;
+    *result = PyObject_CallMethod(mv, "cast", "s(ni)", "d", rows, cols);
+    Py_DECREF(mv);
+    return *result ? 0 : -1;
+}
+
+static void release_output(Py_buffer *view)
+{
+    if (view->obj)
+        PyBuffer_Release(view);
+}
+
+/* ========================================================================
+ * INVENTORY
+ * ======================================================================== */
+
+typedef struct {
+    PyObject_HEAD
+    NetworkSet set;
+    NetRef *refs;                 /* every network, ascending R */
+    int num_refs;
+    int built;                    /* 0 not yet, -1 building, 1 ready */
+} InventoryObject;
+
+static int inventory_init(InventoryObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "values", "part_tol", NULL };
+    PyObject *values, *seq;
+    double part_tol = 0.01;
+    Part *parts;
+    Py_ssize_t count, i;
+    int failed;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|d", kwlist, &values, &part_tol))
+        return -1;
+    /* Other threads may be reading the set with the GIL released */
+    if (self->built) {
+        PyErr_SetString(PyExc_RuntimeError, "Inventory is already built");
+        return -1;
+    }
+    if (part_tol < 0 || part_tol >= 1) {
+        PyErr_SetString(PyExc_ValueError, "part_tol must be in [0, 1)");
+        return -1;
+    }
+    seq = PySequence_Fast(values, "values must be a sequence of resistances");
+    if (!seq)
+        return -1;
+    count = PySequence_Fast_GET_SIZE(seq);
+    if (count == 0 || count > MAX_NETWORKS) {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "values must hold 1 to 10000 resistances");
+        return -1;
+    }
+    parts = malloc(count * sizeof(Part));
+    if (!parts) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        parts[i].R = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+        parts[i].tol = part_tol;
+        parts[i].tcr = 0;
+        parts[i].power = 0;
+        if (parts[i].R <= 0 || !isfinite(parts[i].R)) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_ValueError, "values must be positive");
+            free(parts);
+            Py_DECREF(seq);
+            return -1;
+        }
+    }
+    Py_DECREF(seq);
+
+    self->built = -1;
+    Py_BEGIN_ALLOW_THREADS
+    failed = network_set_build(&self->set, parts, (int)count) != 0;
+    if (!failed) {
+        self->num_refs = network_sorted_refs(&self->set, &self->refs);
+        if (self->num_refs < 0) {
+            network_set_free(&self->set);
+            failed = 1;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    free(parts);
+    if (failed) {
+        self->built = 0;
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->built = 1;
+    return 0;
+}
+
+static void inventory_dealloc(InventoryObject *self)
+{
+    if (self->built == 1) {
+        network_set_free(&self->set);
+        free(self->refs);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t inventory_length(InventoryObject *self)
+{
+    return self->built == 1 ? self->num_refs : 0;
+}
+
+static int check_built(InventoryObject *self)
+{
+    if (self->built != 1) {
+        PyErr_SetString(PyExc_RuntimeError, "Inventory was not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+/* First index of the sorted refs with R >= r */
+static int refs_lower_bound(const NetRef *refs, int count, double r)
+{
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (refs[mid].R < r)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static const Network *ref_network(const InventoryObject *self, int id)
+{
+    return &self->set.level[self->refs[id].n][self->refs[id].i];
+}
+
+/*
+ * Best network for one target: candidates are taken outward from the
+ * target in order of distance, so the first match is the closest and
+ * the walk stops as soon as nothing nearer can follow. Fewer parts win
+ * ties. Returns the network id, or -1.
+ */
+static int best_network(const InventoryObject *self, const SearchSpec *spec, double *error)
+{
+    const NetRef *refs = self->refs;
+    double t = spec->target, limit = spec->tol * (1.0 + 1e-12), best_error = 0;
+    int right = refs_lower_bound(refs, self->num_refs, t), left = right - 1, best = -1;
+
+    while (left >= 0 || right < self->num_refs) {
+        double dl = left >= 0 ? t - refs[left].R : HUGE_VAL;
+        double dr = right < self->num_refs ? refs[right].R - t : HUGE_VAL;
+        int id = dl <= dr ? left-- : right++;
+        double err = (dl <= dr ? dl : dr) / t;
+
+        if (err > limit || (best >= 0 && err > best_error))
+            break;
+        if (network_matches(ref_network(self, id), spec) &&
+            (best < 0 || err < best_error || refs[id].n < refs[best].n)) {
+            best = id;
+            best_error = err;
+        }
+    }
+    *error = best_error;
+    return best;
+}
+
+typedef struct {
+    double error;
+    int id;
+} Match;
+
+static int compare_matches(const void *a, const void *b)
+{
+    const Match *ma = (const Match *)a;
+    const Match *mb = (const Match *)b;
+    if (ma->error < mb->error) return -1;
+    if (ma->error > mb->error) return 1;
+    return ma->id - mb->id;
+}
+
+static PyObject *network_dict(const InventoryObject *self, int id, double error)
+{
+    const Network *net = ref_network(self, id);
+    return Py_BuildValue("{s:s,s:d,s:d,s:i,s:d,s:d,s:i}",
+                         "expr", net->expr, "R", net->R, "error", error, "n", net->n,
+                         "R_lo", net->R_lo, "R_hi", net->R_hi, "id", id);
+}
+
+PyDoc_STRVAR(networks_doc,
+"networks(target, tol=0.01, guaranteed=False, limit=10) -> list of dict\n\n"
+"Networks within tol of target, best first (error, then part count).\n"
+"Each dict has expr, R, error, n, R_lo, R_hi and id.");
+
+static PyObject *inventory_networks(InventoryObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "target", "tol", "guaranteed", "limit", NULL };
+    SearchSpec spec;
+    double target, tol = 0.01;
+    int guaranteed = 0, limit = 10, first, k, total = 0;
+    Match *matches;
+    PyObject *list;
+
+    if (check_built(self) != 0 ||
+        !PyArg_ParseTupleAndKeywords(args, kwds, "d|dpi", kwlist, &target, &tol, &guaranteed, &limit))
+        return NULL;
+    if (target <= 0 || tol < 0) {
+        PyErr_SetString(PyExc_ValueError, "target must be positive and tol non-negative");
+        return NULL;
+    }
+
+    memset(&spec, 0, sizeof(spec));
+    spec.target = target;
+    spec.tol = tol;
+    spec.guaranteed = guaranteed;
+    spec.op_mode = OPERATING_NONE;
+
+    first = refs_lower_bound(self->refs, self->num_refs, target * (1.0 - tol) * (1.0 - 1e-12));
+    for (k = first; k < self->num_refs && self->refs[k].R <= target * (1.0 + tol) * (1.0 + 1e-12); k++)
+        total++;
+    matches = malloc((total > 0 ? total : 1) * sizeof(Match));
+    if (!matches)
+        return PyErr_NoMemory();
+    total = 0;
+    for (k = first; k < self->num_refs && self->refs[k].R <= target * (1.0 + tol) * (1.0 + 1e-12); k++)
+        if (network_matches(ref_network(self, k), &spec)) {
+            matches[total].error = fabs(self->refs[k].R - target) / target;
+            matches[total].id = k;
+            total++;
+        }
+    qsort(matches, total, sizeof(Match), compare_matches);
+
+    list = PyList_New(0);
+    for (k = 0; list && k < total && k < limit; k++) {
+        PyObject *item = network_dict(self, matches[k].id, matches[k].error);
+        if (!item || PyList_Append(list, item) != 0) {
+            Py_XDECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        Py_DECREF(item);
+    }
+    free(matches);
+    return list;
+}
+
+PyDoc_STRVAR(best_doc,
+"best(targets, tol=0.01, guaranteed=False, out=None) -> memoryview\n\n"
+"Closest network to every target, as float64 rows of (R, error, parts,\n"
+"id). Rows without a network within tol are (nan, nan, 0, -1). targets\n"
+"is any C-contiguous float64 or integer buffer and is read in place;\n"
+"numpy.asarray() of the result is a zero-copy (len(targets), 4) array.\n"
+"out, when given, is a writable float64 buffer of that size to fill.");
+
+static PyObject *inventory_best(InventoryObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "targets", "tol", "guaranteed", "out", NULL };
+    PyObject *targets, *out = NULL, *result;
+    Py_buffer in, outview;
+    SearchSpec spec;
+    double tol = 0.01, *data;
+    int guaranteed = 0;
+    Py_ssize_t count, i;
+
+    if (check_built(self) != 0 ||
+        !PyArg_ParseTupleAndKeywords(args, kwds, "O|dpO", kwlist, &targets, &tol, &guaranteed, &out))
+        return NULL;
+    if (tol < 0) {
+        PyErr_SetString(PyExc_ValueError, "tol must be non-negative");
+        return NULL;
+    }
+    if (get_vector(targets, &in, "targets") != 0)
+        return NULL;
+    count = vector_length(&in);
+    if (get_output(out, count, BEST_FIELDS, &outview, &result, &data) != 0) {
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+
+    memset(&spec, 0, sizeof(spec));
+    spec.tol = tol;
+    spec.guaranteed = guaranteed;
+    spec.op_mode = OPERATING_NONE;
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < count; i++) {
+        double *row = data + i * BEST_FIELDS, error;
+        int id = -1;
+
+        spec.target = vector_at(&in, i);
+        if (spec.target > 0 && isfinite(spec.target))
+            id = best_network(self, &spec, &error);
+        if (id >= 0) {
+            row[0] = self->refs[id].R;
+            row[1] = error;
+            row[2] = self->refs[id].n;
+        } else {
+            row[0] = NAN;
+            row[1] = NAN;
+            row[2] = 0;
+        }
+        row[3] = id;
+    }
+    Py_END_ALLOW_THREADS
+
+    release_output(&outview);
+    PyBuffer_Release(&in);
+    return result;
+}
+
+PyDoc_STRVAR(expr_doc,
+"expr(id) -> str\n\nExpression of a network id from networks() or best().");
+
+static PyObject *inventory_expr(InventoryObject *self, PyObject *arg)
+{
+    long id;
+
+    if (check_built(self) != 0)
+        return NULL;
+    id = PyLong_AsLong(arg);
+    if (id == -1 && PyErr_Occurred())
+        return NULL;
+    if (id < 0 || id >= self->num_refs) {
+        PyErr_SetString(PyExc_IndexError, "network id out of range");
+        return NULL;
+    }
+    return PyUnicode_FromString(ref_network(self, (int)id)->expr);
+}
+
+PyDoc_STRVAR(dividers_doc,
+"dividers(ratio, tol=0.01, min_total=0, max_total=0, max_zout=0,\n"
+"         max_parts=0, limit=10) -> list of dict\n\n"
+"(top, bottom) network pairs with Rbot / (Rtop + Rbot) within tol of\n"
+"ratio, best first. Zero limits are off. Each dict has top, bottom,\n"
+"Rtop, Rbot, ratio, error, total, zout and n.");
+
+static PyObject *inventory_dividers(InventoryObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "ratio", "tol", "min_total", "max_total", "max_zout",
+                              "max_parts", "limit", NULL };
+    DividerSpec spec;
+    DividerResult *results;
+    int limit = 10, count, k;
+    PyObject *list;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.tol = 0.01;
+    if (check_built(self) != 0 ||
+        !PyArg_ParseTupleAndKeywords(args, kwds, "d|ddddii", kwlist, &spec.ratio, &spec.tol,
+                                     &spec.min_total, &spec.max_total, &spec.max_zout,
+                                     &spec.max_parts, &limit))
+        return NULL;
+    if (spec.ratio <= 0 || spec.ratio >= 1 || limit < 1) {
+        PyErr_SetString(PyExc_ValueError, "ratio must be between 0 and 1 and limit positive");
+        return NULL;
+    }
+
+    results = malloc(limit * sizeof(DividerResult));
+    if (!results)
+        return PyErr_NoMemory();
+    Py_BEGIN_ALLOW_THREADS
+    count = divider_search_refs(self->refs, self->num_refs, &spec, results, limit);
+    Py_END_ALLOW_THREADS
+    if (count < 0) {
+        free(results);
+        return PyErr_NoMemory();
+    }
+
+    list = PyList_New(0);
+    for (k = 0; list && k < count; k++) {
+        const DividerResult *d = &results[k];
+        PyObject *item = Py_BuildValue("{s:s,s:s,s:d,s:d,s:d,s:d,s:d,s:d,s:i}",
+                                       "top", self->set.level[d->top_n][d->top_i].expr,
+                                       "bottom", self->set.level[d->bot_n][d->bot_i].expr,
+                                       "Rtop", d->Rtop, "Rbot", d->Rbot, "ratio", d->ratio,
+                                       "error", d->error, "total", d->total, "zout", d->zout,
+                                       "n", d->n);
+        if (!item || PyList_Append(list, item) != 0) {
+            Py_XDECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        Py_DECREF(item);
+    }
+    free(results);
+    return list;
+}
+
+static PyMethodDef inventory_methods[] = {
+    { "networks", (PyCFunction)(void (*)(void))inventory_networks, METH_VARARGS | METH_KEYWORDS, networks_doc },
+    { "best", (PyCFunction)(void (*)(void))inventory_best, METH_VARARGS | METH_KEYWORDS, best_doc },
+    { "expr", (PyCFunction)inventory_expr, METH_O, expr_doc },
+    { "dividers", (PyCFunction)(void (*)(void))inventory_dividers, METH_VARARGS | METH_KEYWORDS, dividers_doc },
+    { NULL, NULL, 0, NULL }
+};
+
+static PySequenceMethods inventory_sequence = {
+    .sq_length = (lenfunc)inventory_length,
+};
+
+PyDoc_STRVAR(inventory_doc,
+"Inventory(values, part_tol=0.01)\n\n"
+"Every series/parallel network of up to 5 of the given resistances,\n"
+"built once and kept sorted by R. len() is the number of networks.");
+
+static PyTypeObject InventoryType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "resistorcal.Inventory",
+    .tp_basicsize = sizeof(InventoryObject),
+    .tp_dealloc = (destructor)inventory_dealloc,
+    .tp_as_sequence = &inventory_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = inventory_doc,
+    .tp_methods = inventory_methods,
+    .tp_init = (initproc)inventory_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* ========================================================================
+ * R-2R LADDER
+ * ======================================================================== */
+
+/* Nominal ladder, or one drawn within tol when tol > 0 */
+static int ladder_stats(int bits, double R, double tol, unsigned long seed, double *stats)
+{
+    Ladder lad;
+    LadderLinearity lin;
+
+    if (tol > 0)
+        ladder_sample(&lad, bits, R, tol, seed);
+    else
+        ladder_init_ideal(&lad, bits, R);
+    if (ladder_linearity(&lad, &lin) != 0)
+        return -1;
+    stats[0] = lin.inl_max;
+    stats[1] = lin.inl_min;
+    stats[2] = lin.dnl_max;
+    stats[3] = lin.dnl_min;
+    stats[4] = (double)lin.non_monotonic;
+    stats[5] = lin.gain_error;
+    return 0;
+}
+
+static int check_ladder(int bits, double R, double tol)
+{
+    if (bits < 2 || bits > MAX_R2R_BITS || R <= 0 || tol < 0) {
+        PyErr_SetString(PyExc_ValueError, "bits must be 2-24, R positive and tol non-negative");
+        return -1;
+    }
+    return 0;
+}
+
+PyDoc_STRVAR(r2r_doc,
+"r2r(bits, R=10000, tol=0, seed=1) -> dict\n\n"
+"Full-code linearity (LSB) of a nominal ladder, or of one whose parts\n"
+"are drawn within tol. Keys: inl_max, inl_min, dnl_max, dnl_min,\n"
+"non_monotonic, full_scale, gain_error.");
+
+static PyObject *py_r2r(PyObject *module, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "bits", "R", "tol", "seed", NULL };
+    Ladder lad;
+    LadderLinearity lin;
+    int bits, failed;
+    double R = 10000, tol = 0;
+    unsigned long seed = 1;
+
+    (void)module;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|ddk", kwlist, &bits, &R, &tol, &seed) ||
+        check_ladder(bits, R, tol) != 0)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (tol > 0)
+        ladder_sample(&lad, bits, R, tol, seed);
+    else
+        ladder_init_ideal(&lad, bits, R);
+    failed = ladder_linearity(&lad, &lin) != 0;
+    Py_END_ALLOW_THREADS
+    if (failed)
+        return PyErr_NoMemory();
+
+    return Py_BuildValue("{s:d,s:d,s:d,s:d,s:l,s:d,s:d}",
+                         "inl_max", lin.inl_max, "inl_min", lin.inl_min,
+                         "dnl_max", lin.dnl_max, "dnl_min", lin.dnl_min,
+                         "non_monotonic", lin.non_monotonic,
+                         "full_scale", lin.full_scale, "gain_error", lin.gain_error);
+}
+
+PyDoc_STRVAR(r2r_batch_doc,
+"r2r_batch(bits, R, tol, seeds, out=None) -> memoryview\n\n"
+"Linearity of one tolerance-sampled ladder per seed, as float64 rows of\n"
+"(inl_max, inl_min, dnl_max, dnl_min, non_monotonic, gain_error).\n"
+"seeds and out are buffers as for Inventory.best().");
+
+static PyObject *py_r2r_batch(PyObject *module, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "bits", "R", "tol", "seeds", "out", NULL };
+    PyObject *seeds, *out = NULL, *result;
+    Py_buffer in, outview;
+    double R, tol, *data;
+    int bits, failed = 0;
+    Py_ssize_t count, i;
+
+    (void)module;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "iddO|O", kwlist, &bits, &R, &tol, &seeds, &out) ||
+        check_ladder(bits, R, tol) != 0)
+        return NULL;
+    if (get_vector(seeds, &in, "seeds") != 0)
+        return NULL;
+    count = vector_length(&in);
+    if (get_output(out, count, R2R_FIELDS, &outview, &result, &data) != 0) {
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < count && !failed; i++)
+        failed = ladder_stats(bits, R, tol, (unsigned long)vector_at(&in, i),
+                              data + i * R2R_FIELDS) != 0;
+    Py_END_ALLOW_THREADS
+
+    release_output(&outview);
+    PyBuffer_Release(&in);
+    if (failed) {
+        Py_DECREF(result);
+        return PyErr_NoMemory();
+    }
+    return result;
+}
+
+/* ========================================================================
+ * MODULE
+ * ======================================================================== */
+
+static PyMethodDef module_methods[] = {
+    { "r2r", (PyCFunction)(void (*)(void))py_r2r, METH_VARARGS | METH_KEYWORDS, r2r_doc },
+    { "r2r_batch", (PyCFunction)(void (*)(void))py_r2r_batch, METH_VARARGS | METH_KEYWORDS, r2r_batch_doc },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef resistorcal_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "resistorcal",
+    .m_doc = "Resistor network, divider and R-2R ladder engines.",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit_resistorcal(void)
+{
+    PyObject *module;
+
+    if (PyType_Ready(&InventoryType) < 0)
+        return NULL;
+
+    module = PyModule_Create(&resistorcal_module);
+    if (!module)
+        return NULL;
+    Py_INCREF(&InventoryType);
+    if (PyModule_AddObject(module, "Inventory", (PyObject *)&InventoryType) != 0 ||
+        PyModule_AddIntConstant(module, "MAX_PARTS", MAX_N) != 0) {
+        Py_DECREF(&InventoryType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -13,16 +13,18 @@
 #include <string.h>
 #include <math.h>
 
-#ifdef PLATFORM_MACOS
-#include <CoreFoundation/CoreFoundation.h>
-#endif
+#include "network.h"
+#include "ladder.h"
+#include "service.h"
+#include "shard.h"
 
-#define MAX_N 5           /* maximum resistors in a network */
-#define MAX_NETWORKS 10000
-#define MAX_EXPR 256
 #define MAX_RESULTS 50    /* max results to display */
 #define TOP_N_CODES 5     /* show color codes for top N results */
-#define MAX_R2R_BITS 24   /* max bits for R-2R ladder */
+
+/* Operating temperature range for drift reporting (°C) */
+#define TEMP_MIN -40.0
+#define TEMP_MAX 125.0
+#define TEMP_REF 25.0
 
 /* E24 series base values */
 static const double E24_BASE[] = {
@@ -32,40 +34,8 @@ static const double E24_BASE[] = {
 #define E24_COUNT 24
 #define E24_DECADES 7   /* 1 to 1M */
 
-/* DATADIR is set by cmake at compile time */
-#ifndef DATADIR
-#define DATADIR "."
-#endif
-
-#define MAX_RESISTORS_PER_NET 8  /* max individual resistors tracked */
-
-typedef struct {
-    double R;                      /* equivalent resistance (ohms) */
-    int n;                         /* number of resistors used */
-    char expr[MAX_EXPR];           /* text expression of the network */
-    double parts[MAX_RESISTORS_PER_NET]; /* individual resistor values */
-    int num_parts;                 /* count of parts */
-} Network;
-
-typedef struct {
-    double R;                      /* equivalent resistance */
-    double error;                  /* relative error (0-1) */
-    int n;                         /* number of resistors */
-    char expr[MAX_EXPR];           /* expression */
-    double parts[MAX_RESISTORS_PER_NET]; /* individual resistor values */
-    int num_parts;                 /* count of parts */
-} Result;
-
-/* Comparison function for qsort - sort by error ascending */
-static int compare_results(const void *a, const void *b)
-{
-    const Result *ra = (const Result *)a;
-    const Result *rb = (const Result *)b;
-    if (ra->error < rb->error) return -1;
-    if (ra->error > rb->error) return 1;
-    /* Secondary sort: fewer resistors first */
-    return ra->n - rb->n;
-}
+/* ui.glade, compiled in from data/resistorcal.gresource.xml */
+#define UI_RESOURCE "/com/resistorcal/app/ui.glade"
 
 static GtkBuilder *builder = NULL;
 
@@ -394,27 +364,264 @@ static double parse_resistor_value(const char *label)
     return value;
 }
 
+/* Part families offered in combo_tcr, in combo order */
+enum {
+    FAMILY_THICK_FILM = 0,
+    FAMILY_THIN_FILM,
+    FAMILY_MIXED          /* thin film from 1K up, thick film below */
+};
+
+/* Chip packages offered in combo_package, in combo order */
+static const char *package_names[] = { "0402", "0603", "0805", "1206" };
+static const double package_watts[] = { 0.0625, 0.1, 0.125, 0.25 };
+#define NUM_PACKAGES 4
+
+/*
+ * Typical TCR (ppm/°C) of a chip resistor of the given family.
+ * Thick film: 200 below 10 Ω, 100 above. Thin film: 50 below 10 Ω, 25 above.
+ */
+static double part_tcr(int family, double ohms)
+{
+    if (family == FAMILY_MIXED)
+        family = ohms >= 1000 ? FAMILY_THIN_FILM : FAMILY_THICK_FILM;
+    if (family == FAMILY_THIN_FILM)
+        return ohms < 10 ? 50 : 25;
+    return ohms < 10 ? 200 : 100;
+}
+
 /* ========================================================================
  * NETWORK CALCULATION
  * ======================================================================== */
 
+/*
+ * Collect the resistor values checked on the Network tab.
+ * Returns the number of values stored (at most max).
+ */
+static int collect_selected_values(double *values, int max)
+{
+    GtkWidget *grid_resistors;
+    GList *children, *l;
+    int count = 0;
+
+    grid_resistors = GTK_WIDGET(gtk_builder_get_object(builder, "grid_resistors"));
+    if (!grid_resistors)
+        return 0;
+
+    children = gtk_container_get_children(GTK_CONTAINER(grid_resistors));
+    for (l = children; l != NULL && count < max; l = l->next) {
+        GtkWidget *widget = GTK_WIDGET(l->data);
+        if (GTK_IS_CHECK_BUTTON(widget)) {
+            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget))) {
+                const char *label = gtk_button_get_label(GTK_BUTTON(widget));
+                values[count++] = parse_resistor_value(label);
+            }
+        }
+    }
+    g_list_free(children);
+    return count;
+}
+
+/*
+ * Parts for the network search: the checked values with the part
+ * tolerance, TCR family and package chosen on the Network tab.
+ * Returns the count; part_tol and package receive the settings used.
+ */
+static int collect_network_parts(Part *parts, int max, double *part_tol, int *package)
+{
+    GtkWidget *combo_part_tol, *combo_tcr, *combo_package;
+    double values[100];
+    gchar *tol_text;
+    int family, count, i;
+
+    combo_part_tol = GTK_WIDGET(gtk_builder_get_object(builder, "combo_part_tol"));
+    combo_tcr      = GTK_WIDGET(gtk_builder_get_object(builder, "combo_tcr"));
+    combo_package  = GTK_WIDGET(gtk_builder_get_object(builder, "combo_package"));
+
+    *part_tol = 0.05;
+    if (combo_part_tol) {
+        tol_text = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(combo_part_tol));
+        if (tol_text)
+            *part_tol = atof(tol_text) / 100.0;
+        g_free(tol_text);
+    }
+    family = combo_tcr ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_tcr)) : FAMILY_THICK_FILM;
+    if (family < 0)
+        family = FAMILY_THICK_FILM;
+    *package = combo_package ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_package)) : 1;
+    if (*package < 0 || *package >= NUM_PACKAGES)
+        *package = 1;
+
+    count = collect_selected_values(values, max < 100 ? max : 100);
+    for (i = 0; i < count; i++) {
+        parts[i].R = values[i];
+        parts[i].tol = *part_tol;
+        parts[i].tcr = part_tcr(family, values[i]);
+        parts[i].power = package_watts[*package];
+    }
+    return count;
+}
+
+/* ========================================================================
+ * NETWORK CACHE
+ * ======================================================================== */
+
+/*
+ * The network set of the last Calculate, kept while the parts (values,
+ * tolerance, TCR, package) stay the same. Once the window has drawn its
+ * first frame it is built for the default selection, one level per
+ * G_PRIORITY_LOW idle callback. A Calculate before that finishes builds
+ * the remaining levels itself; a selection change restarts the warm-up
+ * for the new parts.
+ */
+static NetworkSet cache_set;
+static Part cache_parts[100];
+static int cache_count = -1;      /* -1: no set */
+static int cache_level = 0;       /* levels built */
+static guint warmup_source = 0;
+
+static void network_cache_clear(void)
+{
+    if (cache_count >= 0)
+        network_set_free(&cache_set);
+    cache_count = -1;
+    cache_level = 0;
+}
+
+/* Start a set for parts unless the cached one already is. Returns 0 or -1. */
+static int network_cache_begin(const Part *parts, int count)
+{
+    if (cache_count == count && memcmp(cache_parts, parts, count * sizeof(Part)) == 0)
+        return 0;
+    network_cache_clear();
+    if (network_set_begin(&cache_set, parts, count) != 0)
+        return -1;
+    memcpy(cache_parts, parts, count * sizeof(Part));
+    cache_count = count;
+    cache_level = 1;
+    return 0;
+}
+
+/* Build the next level; FALSE when done or on failure */
+static gboolean network_cache_step(void)
+{
+    if (cache_count < 0 || cache_level >= MAX_N)
+        return FALSE;
+    if (network_set_build_level(&cache_set, cache_level + 1) != 0) {
+        network_cache_clear();
+        return FALSE;
+    }
+    cache_level++;
+    return cache_level < MAX_N;
+}
+
+static void warmup_cancel(void)
+{
+    if (warmup_source) {
+        g_source_remove(warmup_source);
+        warmup_source = 0;
+    }
+}
+
+/* The complete set for parts, from the cache when possible; NULL on failure */
+static NetworkSet *network_cache_get(const Part *parts, int count)
+{
+    warmup_cancel();
+    if (network_cache_begin(parts, count) != 0)
+        return NULL;
+    while (network_cache_step())
+        ;
+    return cache_count >= 0 ? &cache_set : NULL;
+}
+
+static gboolean on_warmup_idle(gpointer user_data)
+{
+    (void)user_data;
+    if (network_cache_step())
+        return G_SOURCE_CONTINUE;
+    warmup_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/* Build the set for the current selection in the background */
+static void warmup_start(void)
+{
+    Part parts[100];
+    double part_tol;
+    int package, count;
+
+    warmup_cancel();
+    count = collect_network_parts(parts, 100, &part_tol, &package);
+    if (count == 0 || network_cache_begin(parts, count) != 0)
+        return;
+    if (cache_level < MAX_N)
+        warmup_source = g_idle_add_full(G_PRIORITY_LOW, on_warmup_idle, NULL, NULL);
+}
+
+/* First frame of the window drawn: start warming up, once */
+static gboolean on_first_draw(GtkWidget *widget, cairo_t *cr, gpointer user_data)
+{
+    (void)cr;
+    (void)user_data;
+    g_signal_handlers_disconnect_by_func(widget, G_CALLBACK(on_first_draw), NULL);
+    warmup_start();
+    return FALSE;
+}
+
+/* Checkbox or part setting changed: warm up the new selection instead */
+static void on_selection_changed(GtkWidget *widget, gpointer user_data)
+{
+    (void)widget;
+    (void)user_data;
+    warmup_start();
+}
+
+/* Restart the warm-up whenever the parts of the next Calculate change */
+static void connect_selection_signals(void)
+{
+    static const char *combos[] = { "combo_part_tol", "combo_tcr", "combo_package" };
+    GtkWidget *grid_resistors;
+    GList *children, *l;
+    size_t i;
+
+    grid_resistors = GTK_WIDGET(gtk_builder_get_object(builder, "grid_resistors"));
+    if (grid_resistors) {
+        children = gtk_container_get_children(GTK_CONTAINER(grid_resistors));
+        for (l = children; l != NULL; l = l->next)
+            if (GTK_IS_CHECK_BUTTON(l->data))
+                g_signal_connect(l->data, "toggled", G_CALLBACK(on_selection_changed), NULL);
+        g_list_free(children);
+    }
+    for (i = 0; i < sizeof(combos) / sizeof(combos[0]); i++) {
+        GObject *combo = gtk_builder_get_object(builder, combos[i]);
+        if (combo)
+            g_signal_connect(combo, "changed", G_CALLBACK(on_selection_changed), NULL);
+    }
+}
+
 /*
  * Main calculation - builds all possible series/parallel networks
  * and finds those within tolerance of target.
  */
 static void on_calculate_clicked(GtkButton *button, gpointer user_data)
 {
-    GtkWidget *entry_target, *combo_tol, *textview_output, *grid_resistors;
-    GList *children, *l;
-    double available[100];
-    int numAvail = 0;
-    double target, tolPerc, tol;
+    GtkWidget *entry_target, *combo_tol, *textview_output;
+    GtkWidget *check_mc, *check_guaranteed, *combo_trials;
+    GtkWidget *check_rank_tcr;
+    GtkWidget *combo_op_mode, *entry_op_value, *check_prune_power;
+    Part available[100];
+    int numAvail;
+    double target, tolPerc, tol, part_tol;
     const char *target_text;
     gchar *tol_text = NULL;
-    Network **networks = NULL;
-    int count[MAX_N + 1] = {0};
+    NetworkSet *networks;
+    Result *results = NULL;
+    int num_results;
     int found = 0;
-    int i, n, a, b, j_idx;
+    int i;
+    gboolean run_mc, rank_tcr;
+    int package;
+    SearchSpec spec;
+    McConfig mc;
 
     (void)button;
     (void)user_data;
@@ -422,22 +629,16 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
     entry_target    = GTK_WIDGET(gtk_builder_get_object(builder, "entry_target"));
     combo_tol       = GTK_WIDGET(gtk_builder_get_object(builder, "combo_tolPerc"));
     textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_output"));
-    grid_resistors  = GTK_WIDGET(gtk_builder_get_object(builder, "grid_resistors"));
+    check_mc        = GTK_WIDGET(gtk_builder_get_object(builder, "check_montecarlo"));
+    check_guaranteed = GTK_WIDGET(gtk_builder_get_object(builder, "check_guaranteed"));
+    check_rank_tcr  = GTK_WIDGET(gtk_builder_get_object(builder, "check_rank_tcr"));
+    combo_op_mode   = GTK_WIDGET(gtk_builder_get_object(builder, "combo_op_mode"));
+    entry_op_value  = GTK_WIDGET(gtk_builder_get_object(builder, "entry_op_value"));
+    check_prune_power = GTK_WIDGET(gtk_builder_get_object(builder, "check_prune_power"));
+    combo_trials    = GTK_WIDGET(gtk_builder_get_object(builder, "combo_mc_trials"));
 
-    /* Collect selected resistor values */
-    children = gtk_container_get_children(GTK_CONTAINER(grid_resistors));
-    for (l = children; l != NULL; l = l->next) {
-        GtkWidget *widget = GTK_WIDGET(l->data);
-        if (GTK_IS_CHECK_BUTTON(widget)) {
-            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget))) {
-                const char *label = gtk_button_get_label(GTK_BUTTON(widget));
-                available[numAvail++] = parse_resistor_value(label);
-                if (numAvail >= 100)
-                    break;
-            }
-        }
-    }
-    g_list_free(children);
+    /* Collect selected resistor values with their part settings */
+    numAvail = collect_network_parts(available, 100, &part_tol, &package);
 
     target_text = gtk_entry_get_text(GTK_ENTRY(entry_target));
     target = atof(target_text);
@@ -460,131 +661,57 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
     tolPerc = tol_text ? atof(tol_text) : 5.0;
     g_free(tol_text);
     tol = tolPerc / 100.0;
+    rank_tcr = check_rank_tcr && gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_rank_tcr));
+
+    spec.target = target;
+    spec.tol = tol;
+    spec.guaranteed = check_guaranteed &&
+        gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_guaranteed));
+
+    /* Optional operating point: combo order matches OPERATING_* */
+    spec.op_mode = combo_op_mode ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_op_mode)) : OPERATING_NONE;
+    spec.op_value = entry_op_value ? atof(gtk_entry_get_text(GTK_ENTRY(entry_op_value))) : 0;
+    if (spec.op_mode < 0 || spec.op_value <= 0)
+        spec.op_mode = OPERATING_NONE;
+    spec.prune_overload = spec.op_mode != OPERATING_NONE && check_prune_power &&
+        gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_prune_power));
+
+    /* Monte Carlo yield settings */
+    run_mc = check_mc && gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_mc));
+    mc.target = target;
+    mc.tol = tol;
+    mc.trials = 1000000;
+    mc.seed = 1;
+    if (combo_trials) {
+        const char *id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo_trials));
+        if (id && atol(id) > 0)
+            mc.trials = atol(id);
+    }
 
-    /* FIX: Initialize all pointers to NULL before allocation */
-    networks = malloc((MAX_N + 1) * sizeof(Network *));
+    /* Usually already built by the warm-up or the previous Calculate */
+    networks = network_cache_get(available, numAvail);
     if (!networks) {
         g_printerr("Memory allocation failed\n");
         return;
     }
-    for (i = 0; i <= MAX_N; i++)
-        networks[i] = NULL;
-
-    for (i = 0; i <= MAX_N; i++) {
-        networks[i] = malloc(MAX_NETWORKS * sizeof(Network));
-        if (!networks[i]) {
-            g_printerr("Memory allocation failed\n");
-            goto cleanup;
-        }
-    }
-
-    /* Base case: single resistor networks */
-    for (i = 0; i < numAvail; i++) {
-        if (count[1] < MAX_NETWORKS) {
-            networks[1][count[1]].R = available[i];
-            networks[1][count[1]].n = 1;
-            snprintf(networks[1][count[1]].expr, MAX_EXPR, "%.2f", available[i]);
-            /* Track individual resistor value */
-            networks[1][count[1]].parts[0] = available[i];
-            networks[1][count[1]].num_parts = 1;
-            count[1]++;
-        }
-    }
-
-    /* Build networks with 2..MAX_N resistors */
-    for (n = 2; n <= MAX_N; n++) {
-        count[n] = 0;
-        for (i = 1; i < n; i++) {
-            j_idx = n - i;
-            /*
-             * FIX: Avoid duplicates by only combining when i <= j_idx
-             * For i == j_idx, only combine when a <= b
-             */
-            for (a = 0; a < count[i]; a++) {
-                int b_start = (i == j_idx) ? a : 0;
-                for (b = b_start; b < count[j_idx]; b++) {
-                    char expr[MAX_EXPR];
-                    double R_series, R_parallel;
-                    int p, total_parts;
-
-                    /* Merge parts arrays */
-                    total_parts = networks[i][a].num_parts + networks[j_idx][b].num_parts;
-                    if (total_parts > MAX_RESISTORS_PER_NET)
-                        total_parts = MAX_RESISTORS_PER_NET;
-
-                    /* Series: R = A + B */
-                    if (count[n] < MAX_NETWORKS) {
-                        R_series = networks[i][a].R + networks[j_idx][b].R;
-                        snprintf(expr, MAX_EXPR, "(%s + %s)",
-                                 networks[i][a].expr, networks[j_idx][b].expr);
-                        networks[n][count[n]].R = R_series;
-                        networks[n][count[n]].n = networks[i][a].n + networks[j_idx][b].n;
-                        strncpy(networks[n][count[n]].expr, expr, MAX_EXPR - 1);
-                        networks[n][count[n]].expr[MAX_EXPR - 1] = '\0';
-                        /* Copy parts from both networks */
-                        networks[n][count[n]].num_parts = 0;
-                        for (p = 0; p < networks[i][a].num_parts && networks[n][count[n]].num_parts < MAX_RESISTORS_PER_NET; p++)
-                            networks[n][count[n]].parts[networks[n][count[n]].num_parts++] = networks[i][a].parts[p];
-                        for (p = 0; p < networks[j_idx][b].num_parts && networks[n][count[n]].num_parts < MAX_RESISTORS_PER_NET; p++)
-                            networks[n][count[n]].parts[networks[n][count[n]].num_parts++] = networks[j_idx][b].parts[p];
-                        count[n]++;
-                    }
-
-                    /* Parallel: R = 1/(1/A + 1/B) - use Unicode ∥ symbol */
-                    if (networks[i][a].R > 0 && networks[j_idx][b].R > 0 &&
-                        count[n] < MAX_NETWORKS) {
-                        R_parallel = 1.0 / ((1.0 / networks[i][a].R) +
-                                            (1.0 / networks[j_idx][b].R));
-                        snprintf(expr, MAX_EXPR, "(%s ∥ %s)",
-                                 networks[i][a].expr, networks[j_idx][b].expr);
-                        networks[n][count[n]].R = R_parallel;
-                        networks[n][count[n]].n = networks[i][a].n + networks[j_idx][b].n;
-                        strncpy(networks[n][count[n]].expr, expr, MAX_EXPR - 1);
-                        networks[n][count[n]].expr[MAX_EXPR - 1] = '\0';
-                        /* Copy parts from both networks */
-                        networks[n][count[n]].num_parts = 0;
-                        for (p = 0; p < networks[i][a].num_parts && networks[n][count[n]].num_parts < MAX_RESISTORS_PER_NET; p++)
-                            networks[n][count[n]].parts[networks[n][count[n]].num_parts++] = networks[i][a].parts[p];
-                        for (p = 0; p < networks[j_idx][b].num_parts && networks[n][count[n]].num_parts < MAX_RESISTORS_PER_NET; p++)
-                            networks[n][count[n]].parts[networks[n][count[n]].num_parts++] = networks[j_idx][b].parts[p];
-                        count[n]++;
-                    }
-                }
-            }
-        }
-    }
 
     /* Collect all networks within tolerance into results array */
-    Result *results = malloc(MAX_NETWORKS * sizeof(Result));
-    int num_results = 0;
-    
+    results = malloc(MAX_NETWORKS * sizeof(Result));
     if (!results) {
         g_printerr("Memory allocation failed for results\n");
         goto cleanup;
     }
+    num_results = network_collect(networks, &spec, results, MAX_NETWORKS);
 
-    for (n = 1; n <= MAX_N; n++) {
-        for (i = 0; i < count[n]; i++) {
-            double relError = fabs(networks[n][i].R - target) / target;
-            if (relError <= tol && num_results < MAX_NETWORKS) {
-                int p;
-                results[num_results].R = networks[n][i].R;
-                results[num_results].error = relError;
-                results[num_results].n = networks[n][i].n;
-                strncpy(results[num_results].expr, networks[n][i].expr, MAX_EXPR - 1);
-                results[num_results].expr[MAX_EXPR - 1] = '\0';
-                /* Copy individual parts */
-                results[num_results].num_parts = networks[n][i].num_parts;
-                for (p = 0; p < networks[n][i].num_parts; p++)
-                    results[num_results].parts[p] = networks[n][i].parts[p];
-                num_results++;
-            }
-        }
-    }
+    /* Tempco ranking covers every match, not only the displayed rows */
+    if (rank_tcr && num_results > 0)
+        qsort(results, num_results, sizeof(Result), compare_results_tcr);
 
-    /* Sort results by error (ascending) */
-    if (num_results > 0) {
-        qsort(results, num_results, sizeof(Result), compare_results);
+    /* Monte Carlo on the displayed rows, then re-rank them by yield */
+    if (run_mc && num_results > 0) {
+        int top = num_results < MAX_RESULTS ? num_results : MAX_RESULTS;
+        network_monte_carlo(networks, results, top, &mc);
+        qsort(results, top, sizeof(Result), compare_results_yield);
     }
 
     /* Get text buffer and create color tags */
@@ -602,11 +729,29 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
 
         /* Header */
         snprintf(line, sizeof(line),
-            "\n-- Networks within %.2f%% tolerance of %.2f Ω --\n"
-            "   Found %d combinations, showing top %d sorted by error\n\n",
-            tolPerc, target,
-            num_results, num_results < MAX_RESULTS ? num_results : MAX_RESULTS);
+            "\n-- Networks %swithin %.2f%% tolerance of %.2f Ω --\n"
+            "   Found %d combinations, showing top %d sorted by %s\n",
+            spec.guaranteed ? "guaranteed " : "", tolPerc, target,
+            num_results, num_results < MAX_RESULTS ? num_results : MAX_RESULTS,
+            run_mc ? "yield" : rank_tcr ? "temperature drift" : "error");
         gtk_text_buffer_insert(buffer, &iter, line, -1);
+        if (spec.op_mode != OPERATING_NONE) {
+            snprintf(line, sizeof(line),
+                "   Operating point: %g %s %s, %s parts (%.3g W)%s\n",
+                spec.op_value,
+                spec.op_mode == OPERATING_VOLTAGE ? "V" : "A",
+                spec.op_mode == OPERATING_VOLTAGE ? "across" : "through",
+                package_names[package], package_watts[package],
+                spec.prune_overload ? ", overloaded networks removed" : "");
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+        }
+        if (run_mc) {
+            snprintf(line, sizeof(line),
+                "   Monte Carlo: %ld trials per network, parts ±%.1f%% (3σ)\n",
+                mc.trials, part_tol * 100);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+        }
+        gtk_text_buffer_insert(buffer, &iter, "\n", -1);
 
         for (i = 0; i < num_results && i < MAX_RESULTS; i++) {
             /* Show rank for top 5 */
@@ -624,6 +769,39 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
                 results[i].error * 100);
             gtk_text_buffer_insert(buffer, &iter, line, -1);
 
+            snprintf(line, sizeof(line),
+                "    Worst case %.2f .. %.2f Ω (%+.2f%% .. %+.2f%% of target)\n",
+                results[i].R_lo, results[i].R_hi,
+                (results[i].R_lo - target) / target * 100,
+                (results[i].R_hi - target) / target * 100);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+            snprintf(line, sizeof(line),
+                "    TCR %+.1f ppm/°C, drift %+.0f .. %+.0f ppm over %.0f..%.0f °C\n",
+                results[i].tcr,
+                results[i].tcr * (TEMP_MIN - TEMP_REF),
+                results[i].tcr * (TEMP_MAX - TEMP_REF),
+                TEMP_MIN, TEMP_MAX);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+            if (spec.op_mode != OPERATING_NONE) {
+                snprintf(line, sizeof(line),
+                    "    Power: hottest part at %.0f%% of rating%s\n",
+                    results[i].load * 100,
+                    results[i].load > 1.0 ? "  ⚠ OVERLOAD" : "");
+                gtk_text_buffer_insert(buffer, &iter, line, -1);
+            }
+
+            if (run_mc) {
+                snprintf(line, sizeof(line),
+                    "    Yield %.2f%% | mean %.2f Ω | σ %.2f Ω (%.2f%%)\n",
+                    results[i].yield * 100,
+                    results[i].mc_mean,
+                    results[i].mc_sigma,
+                    results[i].mc_sigma / results[i].mc_mean * 100);
+                gtk_text_buffer_insert(buffer, &iter, line, -1);
+            }
+
             /* Show color codes with visual boxes for top 5 results */
             if (i < TOP_N_CODES) {
                 int already_shown;
@@ -651,6 +829,23 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
                             seen[num_seen++] = results[i].parts[p];
                     }
                 }
+
+                /* Per-part dissipation at the operating point */
+                if (spec.op_mode != OPERATING_NONE) {
+                    double power[MAX_RESISTORS_PER_NET], load[MAX_RESISTORS_PER_NET];
+                    double current = spec.op_mode == OPERATING_VOLTAGE ?
+                        spec.op_value / results[i].R : spec.op_value;
+
+                    network_part_power(networks, results[i].level, results[i].index,
+                                       current, power, load);
+                    gtk_text_buffer_insert(buffer, &iter, "    Part dissipation:\n", -1);
+                    for (p = 0; p < results[i].num_parts; p++) {
+                        snprintf(line, sizeof(line), "      %.2f Ω: %.2f mW (%.0f%% of %s)%s\n",
+                                 results[i].parts[p], power[p] * 1000, load[p] * 100,
+                                 package_names[package], load[p] > 1.0 ? "  ⚠ OVER" : "");
+                        gtk_text_buffer_insert(buffer, &iter, line, -1);
+                    }
+                }
             }
             gtk_text_buffer_insert(buffer, &iter, "\n", -1);
             found = 1;
@@ -683,14 +878,170 @@ static void on_calculate_clicked(GtkButton *button, gpointer user_data)
         gtk_text_buffer_insert(buffer, &iter, "=10%\n", -1);
     }
     
+cleanup:
     free(results);
+}
 
-cleanup:
-    if (networks) {
-        for (i = 0; i <= MAX_N; i++)
-            free(networks[i]);  /* free(NULL) is safe */
-        free(networks);
+/* ========================================================================
+ * VOLTAGE DIVIDER CALCULATOR
+ * ======================================================================== */
+
+/* Divider modes offered in combo_div_mode, in combo order */
+enum {
+    DIVIDER_RATIO = 0,    /* value = Vout/Vin */
+    DIVIDER_REGULATOR,    /* value = regulator Vout, Vout = Vref (1 + Rtop/Rbot) */
+    DIVIDER_GAIN          /* value = non-inverting gain 1 + Rtop/Rbot */
+};
+
+/*
+ * Read an optional numeric entry; empty or invalid text gives 0.
+ */
+static double get_entry_value(const char *id)
+{
+    GtkWidget *entry = GTK_WIDGET(gtk_builder_get_object(builder, id));
+    if (!entry)
+        return 0;
+    return atof(gtk_entry_get_text(GTK_ENTRY(entry)));
+}
+
+/*
+ * Divider search callback: finds top/bottom network pairs for the
+ * requested ratio using the values selected on the Network tab.
+ */
+static void on_divider_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkWidget *combo_mode, *combo_tol, *combo_parts, *textview_output;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    double values[100];
+    Part available[100];
+    int numAvail, mode, i, num_results;
+    double value, vref, tolPerc;
+    gchar *text;
+    char line[1024];
+    char total_str[32], zout_str[32];
+    NetworkSet networks;
+    DividerSpec spec;
+    DividerResult *results;
+
+    (void)button;
+    (void)user_data;
+
+    combo_mode = GTK_WIDGET(gtk_builder_get_object(builder, "combo_div_mode"));
+    combo_tol = GTK_WIDGET(gtk_builder_get_object(builder, "combo_div_tol"));
+    combo_parts = GTK_WIDGET(gtk_builder_get_object(builder, "combo_div_parts"));
+    textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_divider_output"));
+
+    if (!combo_mode || !combo_tol || !combo_parts || !textview_output)
+        return;
+
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview_output));
+
+    mode = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_mode));
+    value = get_entry_value("entry_div_value");
+    vref = get_entry_value("entry_div_vref");
+
+    /* Convert the request into Vout/Vin = Rbot / (Rtop + Rbot) */
+    switch (mode) {
+    case DIVIDER_REGULATOR:
+        spec.ratio = (value > 0 && vref > 0) ? vref / value : 0;
+        break;
+    case DIVIDER_GAIN:
+        spec.ratio = value > 0 ? 1.0 / value : 0;
+        break;
+    default:
+        spec.ratio = value;
+        break;
+    }
+    if (spec.ratio <= 0 || spec.ratio >= 1) {
+        gtk_text_buffer_set_text(buffer,
+            "Error: The requested ratio must be between 0 and 1\n"
+            "(regulator Vout must exceed Vref, gain must exceed 1)", -1);
+        return;
     }
+
+    text = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(combo_tol));
+    tolPerc = text ? atof(text) : 1.0;
+    g_free(text);
+    spec.tol = tolPerc / 100.0;
+    spec.min_total = get_entry_value("entry_div_min_total");
+    spec.max_total = get_entry_value("entry_div_max_total");
+    spec.max_zout = get_entry_value("entry_div_max_zout");
+    text = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(combo_parts));
+    spec.max_parts = text ? atoi(text) : 0;
+    g_free(text);
+
+    numAvail = collect_selected_values(values, 100);
+    if (numAvail == 0) {
+        gtk_text_buffer_set_text(buffer,
+            "Error: Select at least one resistor value on the Network tab", -1);
+        return;
+    }
+    for (i = 0; i < numAvail; i++) {
+        available[i].R = values[i];
+        available[i].tol = 0;
+        available[i].tcr = 0;
+        available[i].power = 0;
+    }
+
+    if (network_set_build(&networks, available, numAvail) != 0) {
+        g_printerr("Memory allocation failed\n");
+        return;
+    }
+    results = malloc(MAX_RESULTS * sizeof(DividerResult));
+    if (!results) {
+        g_printerr("Memory allocation failed for results\n");
+        network_set_free(&networks);
+        return;
+    }
+    num_results = divider_search(&networks, &spec, results, MAX_RESULTS);
+
+    create_color_tags(buffer);
+    gtk_text_buffer_set_text(buffer, "", -1);
+    gtk_text_buffer_get_end_iter(buffer, &iter);
+
+    snprintf(line, sizeof(line),
+        "\n-- Dividers within %.2f%% of Vout/Vin = %.6f --\n"
+        "   Showing best %d, sorted by error (Rtop from Vin to Vout, Rbot to GND)\n\n",
+        tolPerc, spec.ratio, num_results > 0 ? num_results : 0);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+    for (i = 0; i < num_results; i++) {
+        const DividerResult *d = &results[i];
+
+        if (i < TOP_N_CODES) {
+            snprintf(line, sizeof(line), "#%d ", i + 1);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+        }
+        snprintf(line, sizeof(line),
+            "Rtop %s = %.2f Ω\n    Rbot %s = %.2f Ω\n",
+            networks.level[d->top_n][d->top_i].expr, d->Rtop,
+            networks.level[d->bot_n][d->bot_i].expr, d->Rbot);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+        format_resistance(d->total, total_str, sizeof(total_str));
+        format_resistance(d->zout, zout_str, sizeof(zout_str));
+        snprintf(line, sizeof(line),
+            "    ratio %.6f (error %.3f%%) | total %s | Zout %s | %d resistors\n",
+            d->ratio, d->error * 100, total_str, zout_str, d->n);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+        if (mode == DIVIDER_REGULATOR) {
+            snprintf(line, sizeof(line), "    Vout = %.4f V, feedback current %.1f µA\n",
+                     vref / d->ratio, vref / d->Rbot * 1e6);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+        } else if (mode == DIVIDER_GAIN) {
+            snprintf(line, sizeof(line), "    Gain = %.5f\n", 1.0 / d->ratio);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+        }
+        gtk_text_buffer_insert(buffer, &iter, "\n", -1);
+    }
+
+    if (num_results <= 0)
+        gtk_text_buffer_insert(buffer, &iter, "No divider found within the specified constraints.\n", -1);
+
+    free(results);
+    network_set_free(&networks);
 }
 
 /* ========================================================================
@@ -750,43 +1101,204 @@ static double get_r_value_from_index(int idx)
     return E24_BASE[base_idx] * pow(10, decade);
 }
 
+/* Resistor model of the ladder: order matches combo_r2r_model */
+enum {
+    R2R_MODEL_IDEAL = 0,
+    R2R_MODEL_SAMPLE,     /* one random draw within the part tolerance */
+    R2R_MODEL_MEASURED    /* values read from a CSV file */
+};
+
+/*
+ * Part tolerance selected on the R-2R tab.
+ */
+static double get_r2r_tol(void)
+{
+    GtkWidget *combo_tol = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_tol"));
+    const char *id;
+
+    if (combo_tol) {
+        id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo_tol));
+        if (id && atof(id) > 0)
+            return atof(id);
+    }
+    return 0.001;
+}
+
+/*
+ * Build the ladder for the selected resistor model. Returns FALSE and
+ * fills err if the measured values cannot be loaded.
+ */
+static gboolean build_r2r_ladder(Ladder *lad, int bits, double R, int model,
+                                 char *err, size_t errsize)
+{
+    GtkWidget *file_csv;
+    gchar *path;
+    double ron;
+    int loaded, k;
+
+    switch (model) {
+    case R2R_MODEL_SAMPLE:
+        ladder_sample(lad, bits, R, get_r2r_tol(), (unsigned long)get_entry_value("entry_r2r_seed"));
+        break;
+    case R2R_MODEL_MEASURED:
+        file_csv = GTK_WIDGET(gtk_builder_get_object(builder, "file_r2r_csv"));
+        path = file_csv ? gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(file_csv)) : NULL;
+        if (!path) {
+            snprintf(err, errsize, "Select a CSV file of measured values.\n");
+            return FALSE;
+        }
+        loaded = ladder_load_csv(lad, bits, R, path);
+        if (loaded <= 0) {
+            snprintf(err, errsize, "No ladder values read from %s\n"
+                     "Expected rows of name,ohms with name R<k>, 2R<k> or TERM.\n", path);
+            g_free(path);
+            return FALSE;
+        }
+        g_free(path);
+        break;
+    default:
+        ladder_init_ideal(lad, bits, R);
+        break;
+    }
+
+    /* Switch resistance and load from the tab override the CSV values */
+    ron = get_entry_value("entry_r2r_ron");
+    if (ron > 0)
+        for (k = 0; k < lad->bits; k++)
+            lad->ron[k] = ron;
+    if (get_entry_value("entry_r2r_load") > 0)
+        lad->load = get_entry_value("entry_r2r_load");
+    return TRUE;
+}
+
+/* Mismatch Monte Carlo settings from the R-2R tab */
+static void get_r2r_mc_config(LadderMcConfig *cfg, int bits, double R)
+{
+    GtkWidget *combo_trials;
+
+    cfg->bits = bits;
+    cfg->tol = get_r2r_tol();
+    cfg->trials = 10000;
+    cfg->seed = (unsigned long)get_entry_value("entry_r2r_seed");
+    cfg->ron = get_entry_value("entry_r2r_ron") / R;
+    if (cfg->ron < 0)
+        cfg->ron = 0;
+    combo_trials = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_trials"));
+    if (combo_trials) {
+        const char *id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo_trials));
+        if (id && atol(id) > 0)
+            cfg->trials = atol(id);
+    }
+}
+
+/*
+ * Mismatch Monte Carlo over every ladder size up to bits, appended to
+ * the R-2R output as one row per bit count.
+ */
+static void insert_r2r_monte_carlo(GtkTextBuffer *buffer, GtkTextIter *iter,
+                                   int bits, double R)
+{
+    LadderMcConfig cfg;
+    LadderMcStats stats[MAX_R2R_BITS];
+    char line[512];
+    int i, count, best = 0;
+    gint64 t0;
+
+    get_r2r_mc_config(&cfg, bits, R);
+
+    t0 = g_get_monotonic_time();
+    count = ladder_monte_carlo(&cfg, stats);
+    if (count < 0) {
+        g_printerr("Memory allocation failed for ladder Monte Carlo\n");
+        return;
+    }
+
+    snprintf(line, sizeof(line),
+        "MISMATCH MONTE CARLO (%g%% parts, %ld trials)\n"
+        "──────────────────────────────────────────────────────────────\n"
+        "  Bits  Monotonic  |DNL|<=1  |INL|<=0.5   max|DNL| p50/p99   max|INL| p50/p99\n",
+        cfg.tol * 100, cfg.trials);
+    gtk_text_buffer_insert(buffer, iter, line, -1);
+
+    for (i = 0; i < count; i++) {
+        const LadderMcStats *st = &stats[i];
+        snprintf(line, sizeof(line),
+            "  %4d   %6.1f%%   %6.1f%%    %6.1f%%    %7.3f / %-8.3f  %7.3f / %-8.3f\n",
+            st->bits, st->p_monotonic * 100, st->p_dnl_1lsb * 100,
+            st->p_inl_half_lsb * 100, st->dnl_p50, st->dnl_p99,
+            st->inl_p50, st->inl_p99);
+        gtk_text_buffer_insert(buffer, iter, line, -1);
+        if (st->p_dnl_1lsb >= 0.99)
+            best = st->bits;
+    }
+
+    if (best)
+        snprintf(line, sizeof(line),
+            "\n  At %g%%, up to %d bits keep |DNL| <= 1 LSB in 99%% of ladders.\n",
+            cfg.tol * 100, best);
+    else
+        snprintf(line, sizeof(line),
+            "\n  At %g%%, no ladder size keeps |DNL| <= 1 LSB in 99%% of ladders.\n",
+            cfg.tol * 100);
+    gtk_text_buffer_insert(buffer, iter, line, -1);
+    snprintf(line, sizeof(line), "  Computed in %.1f ms\n\n",
+             (g_get_monotonic_time() - t0) / 1000.0);
+    gtk_text_buffer_insert(buffer, iter, line, -1);
+}
+
+/*
+ * Read R, bit count and Vref from the R-2R tab.
+ */
+static gboolean get_r2r_selection(double *R, int *bits, double *vref)
+{
+    GtkWidget *combo_r, *combo_bits, *entry_vref;
+
+    combo_r = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r_value"));
+    combo_bits = GTK_WIDGET(gtk_builder_get_object(builder, "combo_bits"));
+    entry_vref = GTK_WIDGET(gtk_builder_get_object(builder, "entry_vref"));
+
+    if (!combo_r || !combo_bits || !entry_vref)
+        return FALSE;
+
+    *R = get_r_value_from_index(gtk_combo_box_get_active(GTK_COMBO_BOX(combo_r)));
+    *bits = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_bits)) + 2;  /* index 0 = 2-bit */
+    *vref = atof(gtk_entry_get_text(GTK_ENTRY(entry_vref)));
+    if (*vref <= 0) *vref = 5.0;
+    return TRUE;
+}
+
 /*
  * R-2R Ladder generation callback.
  */
 static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
 {
-    GtkWidget *combo_r, *combo_bits, *entry_vref, *textview_output;
+    GtkWidget *textview_output;
     GtkTextBuffer *buffer;
     GtkTextIter iter;
-    int r_idx, bit_idx, bits;
+    int bits;
     double R, R2, vref, lsb;
     int r_count, r2_count, total;
-    const char *vref_text;
     char line[512];
     char r_str[32], r2_str[32], lsb_str[32];
-    int i, num_samples;
-    double max_val;
+    int i, num_samples, model;
+    double max_val, zout, gain[MAX_R2R_BITS];
+    GtkWidget *combo_model, *check_mc;
+    Ladder lad;
+    LadderLinearity lin;
+    gint64 t0;
+    char err[512];
 
     (void)button;
     (void)user_data;
 
-    combo_r = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r_value"));
-    combo_bits = GTK_WIDGET(gtk_builder_get_object(builder, "combo_bits"));
-    entry_vref = GTK_WIDGET(gtk_builder_get_object(builder, "entry_vref"));
     textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_r2r_output"));
 
-    if (!combo_r || !combo_bits || !entry_vref || !textview_output)
+    if (!textview_output || !get_r2r_selection(&R, &bits, &vref))
         return;
-
-    r_idx = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_r));
-    bit_idx = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_bits));
-    bits = bit_idx + 2;  /* bits = 2 to 24, index 0 = 2-bit */
-    R = get_r_value_from_index(r_idx);
     R2 = R * 2;
 
-    vref_text = gtk_entry_get_text(GTK_ENTRY(entry_vref));
-    vref = atof(vref_text);
-    if (vref <= 0) vref = 5.0;
+    combo_model = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_model"));
+    model = combo_model ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_model)) : R2R_MODEL_IDEAL;
 
     /* Calculate component counts */
     r_count = bits - 1;    /* N-1 R resistors in horizontal chain */
@@ -805,6 +1317,12 @@ static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
     gtk_text_buffer_set_text(buffer, "", -1);
     gtk_text_buffer_get_end_iter(buffer, &iter);
 
+    if (!build_r2r_ladder(&lad, bits, R, model, err, sizeof(err))) {
+        gtk_text_buffer_insert(buffer, &iter, err, -1);
+        return;
+    }
+    ladder_gains(&lad, gain, &zout);
+
     /* Header */
     snprintf(line, sizeof(line),
         "\n══════════════════════════════════════════════════════════════\n"
@@ -836,6 +1354,51 @@ static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
         vref, lsb_str, max_val, max_val - 1, vref * (max_val - 1) / max_val);
     gtk_text_buffer_insert(buffer, &iter, line, -1);
 
+    /* Linearity over every code of the modelled ladder */
+    t0 = g_get_monotonic_time();
+    if (ladder_linearity(&lad, &lin) != 0) {
+        g_printerr("Memory allocation failed for linearity analysis\n");
+        return;
+    }
+    format_resistance(zout, r_str, sizeof(r_str));
+    snprintf(line, sizeof(line),
+        "LINEARITY (%s, endpoint fit, all %.0f codes)\n"
+        "──────────────────────────────────────────────────────────────\n"
+        "  INL:       %+.4f LSB (code %ld) .. %+.4f LSB (code %ld)\n"
+        "  DNL:       %+.4f LSB (code %ld) .. %+.4f LSB (code %ld)\n"
+        "  Monotonic: %s",
+        model == R2R_MODEL_SAMPLE ? "tolerance sample" :
+        model == R2R_MODEL_MEASURED ? "measured values" : "ideal parts",
+        max_val, lin.inl_min, lin.inl_min_code, lin.inl_max, lin.inl_max_code,
+        lin.dnl_min, lin.dnl_min_code, lin.dnl_max, lin.dnl_max_code,
+        lin.non_monotonic ? "NO" : "yes");
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+    if (lin.non_monotonic) {
+        snprintf(line, sizeof(line), " (%ld down-steps)", lin.non_monotonic);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+    }
+    snprintf(line, sizeof(line),
+        "\n  Gain err:  %+.4f%% of full scale\n"
+        "  Zout:      %s\n",
+        lin.gain_error * 100, r_str);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+    if (lad.ron[bits - 1] > 0 || lad.load > 0) {
+        char ron_str[32], load_str[32];
+        format_resistance(lad.ron[bits - 1], ron_str, sizeof(ron_str));
+        format_resistance(lad.load, load_str, sizeof(load_str));
+        snprintf(line, sizeof(line), "  Switches:  Ron %s (MSB), load %s\n",
+                 ron_str, lad.load > 0 ? load_str : "none");
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+    }
+    snprintf(line, sizeof(line), "  Computed in %.1f ms\n\n",
+             (g_get_monotonic_time() - t0) / 1000.0);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+    format_resistance(R, r_str, sizeof(r_str));
+
+    check_mc = GTK_WIDGET(gtk_builder_get_object(builder, "check_r2r_mc"));
+    if (check_mc && gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_mc)))
+        insert_r2r_monte_carlo(buffer, &iter, bits, R);
+
     /* Color codes for R */
     gtk_text_buffer_insert(buffer, &iter, "RESISTOR COLOR CODES\n", -1);
     gtk_text_buffer_insert(buffer, &iter, "──────────────────────────────────────────────────────────────\n", -1);
@@ -856,16 +1419,16 @@ static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
     gtk_text_buffer_insert(buffer, &iter, "──────────────────────────────────────────────────────────────\n", -1);
 
     if (bits <= 12) {
-        gtk_text_buffer_insert(buffer, &iter, "  Binary           Dec      Vout\n", -1);
+        gtk_text_buffer_insert(buffer, &iter, "  Binary           Dec      Vout        INL\n", -1);
     } else {
-        gtk_text_buffer_insert(buffer, &iter, "  Hex          Decimal         Vout\n", -1);
+        gtk_text_buffer_insert(buffer, &iter, "  Hex          Decimal         Vout        INL\n", -1);
     }
-    gtk_text_buffer_insert(buffer, &iter, "  ─────────────────────────────────\n", -1);
+    gtk_text_buffer_insert(buffer, &iter, "  ───────────────────────────────────────────\n", -1);
 
     num_samples = (bits <= 4) ? (int)max_val : 16;
     for (i = 0; i < num_samples; i++) {
-        int d;
-        double voltage;
+        int d, b;
+        double voltage, inl;
         char code_str[32];
         
         if (bits <= 4) {
@@ -875,22 +1438,27 @@ static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
             d = (int)(i * (max_val - 1) / 15);
         }
         
-        voltage = vref * d / max_val;
+        /* Vout from the modelled parts; INL against the endpoint line */
+        voltage = 0;
+        for (b = 0; b < bits; b++)
+            if (d & (1 << b))
+                voltage += gain[b];
+        inl = voltage * (max_val - 1) / lin.full_scale - d;
+        voltage *= vref;
         
         if (bits <= 12) {
             /* Binary format for <= 12 bits */
-            int b;
             char *p = code_str;
             for (b = bits - 1; b >= 0; b--) {
                 *p++ = (d & (1 << b)) ? '1' : '0';
             }
             *p = '\0';
-            snprintf(line, sizeof(line), "  %-14s %5d    %.6fV\n", code_str, d, voltage);
+            snprintf(line, sizeof(line), "  %-14s %5d    %.6fV  %+.3f\n", code_str, d, voltage, inl);
         } else {
             /* Hex format for > 12 bits */
             int hex_digits = (bits + 3) / 4;
             snprintf(code_str, sizeof(code_str), "0x%0*X", hex_digits, d);
-            snprintf(line, sizeof(line), "  %-10s %10d    %.6fV\n", code_str, d, voltage);
+            snprintf(line, sizeof(line), "  %-10s %10d    %.6fV  %+.3f\n", code_str, d, voltage, inl);
         }
         gtk_text_buffer_insert(buffer, &iter, line, -1);
     }
@@ -949,87 +1517,409 @@ static void on_r2r_generate_clicked(GtkButton *button, gpointer user_data)
         "  Formula: Vout = Vref × (Digital_Value / 2^N)\n\n", -1);
 }
 
-/* ========================================================================
- * UI LOADING
- * ======================================================================== */
+/*
+ * Ask for a file to save to. Returns the path (caller frees) or NULL.
+ */
+static gchar *choose_save_path(GtkWidget *parent, const char *title, const char *name)
+{
+    GtkWidget *dialog;
+    gchar *path = NULL;
+
+    dialog = gtk_file_chooser_dialog_new(title,
+        GTK_WINDOW(gtk_widget_get_toplevel(parent)),
+        GTK_FILE_CHOOSER_ACTION_SAVE,
+        "_Cancel", GTK_RESPONSE_CANCEL,
+        "_Save", GTK_RESPONSE_ACCEPT,
+        NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), name);
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+        path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+    gtk_widget_destroy(dialog);
+    return path;
+}
 
 /*
- * Get the directory containing the executable.
- * Used to find resources relative to the binary.
+ * Export the complete code table of the modelled ladder to a file. The
+ * table is streamed to disk, never through the text view.
  */
-static void get_exe_dir(char *buf, size_t bufsize, const char *argv0)
+static void on_r2r_export_clicked(GtkButton *button, gpointer user_data)
 {
-#ifdef PLATFORM_MACOS
-    /* macOS: Use bundle path */
-    CFBundleRef bundle = CFBundleGetMainBundle();
-    if (bundle) {
-        CFURLRef resourcesURL = CFBundleCopyResourcesDirectoryURL(bundle);
-        if (resourcesURL) {
-            CFURLGetFileSystemRepresentation(resourcesURL, TRUE,
-                                             (UInt8 *)buf, bufsize);
-            CFRelease(resourcesURL);
-            return;
-        }
+    static const char *suffix[] = { "csv", "f32", "f64" };
+    GtkWidget *combo_model, *combo_format, *textview_output;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    double R, vref;
+    int bits, model, format;
+    char name[64], line[1024], err[512];
+    gchar *path;
+    Ladder lad;
+    gint64 t0;
+
+    (void)user_data;
+
+    textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_r2r_output"));
+    combo_model = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_model"));
+    combo_format = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_export"));
+    if (!textview_output || !get_r2r_selection(&R, &bits, &vref))
+        return;
+
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview_output));
+    gtk_text_buffer_get_end_iter(buffer, &iter);
+
+    model = combo_model ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_model)) : R2R_MODEL_IDEAL;
+    format = combo_format ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_format)) : LADDER_EXPORT_CSV;
+    if (format < LADDER_EXPORT_CSV || format > LADDER_EXPORT_F64)
+        format = LADDER_EXPORT_CSV;
+    if (!(vref <= MAX_EXPORT_VREF)) {
+        snprintf(line, sizeof(line), "\nVref must be a number up to %g V to export.\n", MAX_EXPORT_VREF);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+        return;
+    }
+    if (!build_r2r_ladder(&lad, bits, R, model, err, sizeof(err))) {
+        gtk_text_buffer_insert(buffer, &iter, err, -1);
+        return;
     }
-#endif
-
-    /* Fallback: derive from argv[0] */
-    const char *last_slash = strrchr(argv0, '/');
-#ifdef PLATFORM_WINDOWS
-    const char *last_bslash = strrchr(argv0, '\\');
-    if (last_bslash > last_slash)
-        last_slash = last_bslash;
-#endif
-    if (last_slash) {
-        size_t len = last_slash - argv0;
-        if (len >= bufsize) len = bufsize - 1;
-        memcpy(buf, argv0, len);
-        buf[len] = '\0';
+
+    snprintf(name, sizeof(name), "r2r_%dbit.%s", bits, suffix[format]);
+    path = choose_save_path(GTK_WIDGET(button), "Export Code Table", name);
+    if (!path)
+        return;
+
+    t0 = g_get_monotonic_time();
+    if (ladder_export(&lad, vref, format, path) != 0) {
+        g_printerr("Failed to write %s\n", path);
+        snprintf(line, sizeof(line), "\nExport to %s failed.\n", path);
     } else {
-        strncpy(buf, ".", bufsize - 1);
-        buf[bufsize - 1] = '\0';
+        snprintf(line, sizeof(line), "\nExported %ld codes to %s in %.1f ms\n",
+                 1L << bits, path, (g_get_monotonic_time() - t0) / 1000.0);
     }
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+    g_free(path);
 }
 
 /*
- * Try to load UI file from multiple locations:
- * 1. DATADIR (set at compile time, e.g., /usr/share/resistorcal)
- * 2. Current directory (for development)
- * 3. Alongside the executable
- * 4. macOS: Inside app bundle Resources
+ * Read an integer setting from a combo's active id.
  */
-static gboolean load_ui(GtkBuilder *bldr, const char *argv0)
+static int get_combo_id_int(const char *id, int fallback)
 {
-    char path[1024];
-    char exe_dir[1024];
-    const char *locations[] = {
-        DATADIR "/ui.glade",
-        "ui.glade",
-        "data/ui.glade",
-        NULL
-    };
-    int i;
+    GtkWidget *combo = GTK_WIDGET(gtk_builder_get_object(builder, id));
+    const char *active;
+
+    if (!combo)
+        return fallback;
+    active = gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
+    return active ? atoi(active) : fallback;
+}
+
+/*
+ * Generate a firmware calibration LUT from the modelled (normally
+ * measured) ladder. A .h file name gives a C header, anything else a
+ * raw binary table.
+ */
+static void on_r2r_cal_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkWidget *combo_model, *combo_rounding, *textview_output;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    double R, vref, full_scale;
+    int bits, model, rc;
+    char line[1024], err[512];
+    const char *rounding;
+    gchar *path;
+    LadderCalSpec spec;
+    LadderCal cal;
+    Ladder lad;
+    gint64 t0;
+
+    (void)user_data;
+
+    textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_r2r_output"));
+    combo_model = GTK_WIDGET(gtk_builder_get_object(builder, "combo_r2r_model"));
+    combo_rounding = GTK_WIDGET(gtk_builder_get_object(builder, "combo_cal_rounding"));
+    if (!textview_output || !get_r2r_selection(&R, &bits, &vref))
+        return;
+
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview_output));
+    gtk_text_buffer_get_end_iter(buffer, &iter);
+
+    if (bits > MAX_CAL_BITS) {
+        snprintf(line, sizeof(line), "\nCalibration LUTs are limited to %d-bit ladders.\n",
+                 MAX_CAL_BITS);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+        return;
+    }
+
+    model = combo_model ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo_model)) : R2R_MODEL_IDEAL;
+    if (!build_r2r_ladder(&lad, bits, R, model, err, sizeof(err))) {
+        gtk_text_buffer_insert(buffer, &iter, err, -1);
+        return;
+    }
+
+    /* Targets span 0 to the lower of the ideal and real full scale */
+    full_scale = ladder_output(&lad, (1L << bits) - 1);
+    spec.depth = get_combo_id_int("combo_cal_depth", 12);
+    if (spec.depth > bits)
+        spec.depth = bits;
+    spec.interp_bits = get_combo_id_int("combo_cal_interp", 0);
+    rounding = combo_rounding ? gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo_rounding)) : NULL;
+    spec.rounding = rounding && strcmp(rounding, "below") == 0 ? LADDER_CAL_BELOW : LADDER_CAL_NEAREST;
+    spec.v_lo = 0;
+    spec.v_hi = fmin(full_scale, ((1L << bits) - 1) / (double)(1L << bits));
+
+    path = choose_save_path(GTK_WIDGET(button), "Save Calibration LUT", "ladder_cal.h");
+    if (!path)
+        return;
 
-    /* Try standard locations first */
-    for (i = 0; locations[i] != NULL; i++) {
-        if (gtk_builder_add_from_file(bldr, locations[i], NULL) != 0)
-            return TRUE;
+    t0 = g_get_monotonic_time();
+    if (ladder_calibrate(&lad, &spec, &cal) != 0) {
+        g_printerr("Calibration LUT generation failed\n");
+        g_free(path);
+        return;
+    }
+    rc = g_str_has_suffix(path, ".h") ? ladder_cal_write_header(&cal, path, "ladder_cal")
+                                      : ladder_cal_write_binary(&cal, path);
+    if (rc != 0) {
+        g_printerr("Failed to write %s\n", path);
+        snprintf(line, sizeof(line), "\nWriting %s failed.\n", path);
+    } else {
+        snprintf(line, sizeof(line),
+            "\nCALIBRATION LUT\n"
+            "──────────────────────────────────────────────────────────────\n"
+            "  Entries:   %ld (%d-bit index, %d interpolated bits)\n"
+            "  Range:     0 .. %.6fV\n"
+            "  Error:     %.3f LSB worst, %.3f LSB RMS at table points\n"
+            "  Written:   %s (%.1f ms)\n",
+            cal.size, spec.depth, spec.interp_bits, spec.v_hi * vref,
+            cal.max_error, cal.rms_error, path, (g_get_monotonic_time() - t0) / 1000.0);
     }
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+    ladder_cal_free(&cal);
+    g_free(path);
+}
+
+#define SEGMENT_BAR 30  /* chart width for the largest p99 INL */
+
+/*
+ * Segmented DAC explorer: Monte Carlo linearity of every split into
+ * thermometer MSBs and R-2R LSBs, charted against part count.
+ */
+static void on_r2r_segment_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkWidget *textview_output;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    LadderMcConfig cfg;
+    LadderSegment seg[MAX_SEGMENT_BITS];
+    double R, vref, worst = 0;
+    int bits, count, i, j, best = 0;
+    char line[512], bar[SEGMENT_BAR + 1];
+    gint64 t0;
 
-    /* Get directory of executable */
-    get_exe_dir(exe_dir, sizeof(exe_dir), argv0);
+    (void)button;
+    (void)user_data;
+
+    textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_r2r_output"));
+    if (!textview_output || !get_r2r_selection(&R, &bits, &vref))
+        return;
 
-    /* Try in exe directory (Windows portable, macOS bundle) */
-    snprintf(path, sizeof(path), "%s/ui.glade", exe_dir);
-    if (gtk_builder_add_from_file(bldr, path, NULL) != 0)
-        return TRUE;
+    get_r2r_mc_config(&cfg, bits, R);
+    t0 = g_get_monotonic_time();
+    count = ladder_segmented_mc(&cfg, MAX_SEGMENT_BITS, seg);
+    if (count < 0) {
+        g_printerr("Memory allocation failed for segmentation Monte Carlo\n");
+        return;
+    }
 
-    /* Try Linux install location relative to exe */
-    snprintf(path, sizeof(path), "%s/../share/resistorcal/ui.glade", exe_dir);
-    if (gtk_builder_add_from_file(bldr, path, NULL) != 0)
-        return TRUE;
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview_output));
+    gtk_text_buffer_set_text(buffer, "", -1);
+    gtk_text_buffer_get_end_iter(buffer, &iter);
 
-    return FALSE;
+    snprintf(line, sizeof(line),
+        "\n══════════════════════════════════════════════════════════════\n"
+        "         SEGMENTED DAC EXPLORER (%d-bit, %g%% parts)\n"
+        "══════════════════════════════════════════════════════════════\n\n"
+        "  k thermometer MSBs (2^k - 1 unit 2R legs) + %d-k bit R-2R LSBs\n"
+        "  %ld Monte Carlo builds per k in %.1f ms\n\n"
+        "   k  Parts  |DNL|<=1   max|DNL| p50/p99   max|INL| p50/p99   INL p99\n"
+        "──────────────────────────────────────────────────────────────\n",
+        bits, cfg.tol * 100, bits, cfg.trials,
+        (g_get_monotonic_time() - t0) / 1000.0);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+    for (i = 0; i < count; i++)
+        if (seg[i].lin.inl_p99 > worst)
+            worst = seg[i].lin.inl_p99;
+
+    /* Trade-off curve: parts against p99 INL */
+    for (i = 0; i < count; i++) {
+        const LadderSegment *s = &seg[i];
+        int len = worst > 0 ? (int)(s->lin.inl_p99 / worst * SEGMENT_BAR + 0.5) : 0;
+
+        for (j = 0; j < len; j++)
+            bar[j] = '#';
+        bar[len] = '\0';
+        snprintf(line, sizeof(line),
+            "  %2d  %5d  %6.1f%%   %7.3f / %-8.3f  %7.3f / %-8.3f  %s\n",
+            s->k, s->parts, s->lin.p_dnl_1lsb * 100, s->lin.dnl_p50,
+            s->lin.dnl_p99, s->lin.inl_p50, s->lin.inl_p99, bar);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+        if (!best && s->lin.p_dnl_1lsb >= 0.99)
+            best = s->k;
+    }
+
+    if (best)
+        snprintf(line, sizeof(line),
+            "\n  Fewest parts with |DNL| <= 1 LSB in 99%% of builds: k = %d (%d parts)\n",
+            best, seg[best - 1].parts);
+    else
+        snprintf(line, sizeof(line),
+            "\n  No segmentation up to k = %d keeps |DNL| <= 1 LSB in 99%% of builds\n",
+            count);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+}
+
+#define SYNTH_SHOW 5    /* ladders listed per leg size */
+
+/*
+ * Text form of a synthesized 2R leg, e.g. "10K + 10K".
+ */
+static void format_synth_leg(const LadderSynth *syn, char *buf, size_t bufsize)
+{
+    char a[32], b[32], c[32];
+    const char *op0 = syn->op[0] == NET_SERIES ? "+" : "∥";
+    const char *op1 = syn->op[1] == NET_SERIES ? "+" : "∥";
+
+    format_resistance(syn->v[0], a, sizeof(a));
+    format_resistance(syn->v[1], b, sizeof(b));
+    format_resistance(syn->v[2], c, sizeof(c));
+    if (syn->leg_parts == 1)
+        snprintf(buf, bufsize, "%s", a);
+    else if (syn->leg_parts == 2)
+        snprintf(buf, bufsize, "%s %s %s", a, op0, b);
+    else
+        snprintf(buf, bufsize, "%s %s (%s %s %s)", a, op0, b, op1, c);
+}
+
+/*
+ * Synthesize R-2R ladders from the values selected on the Network tab
+ * (all E24 values when none are selected).
+ */
+static void on_r2r_synth_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkWidget *textview_output;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    double values[E24_COUNT * E24_DECADES], R, vref;
+    LadderSynthSpec spec;
+    LadderSynth *results;
+    int count, num_results, bits, d, i, p, shown;
+    char line[512], r_str[32], leg_str[128];
+    gint64 t0;
+
+    (void)button;
+    (void)user_data;
+
+    textview_output = GTK_WIDGET(gtk_builder_get_object(builder, "textview_r2r_output"));
+    if (!textview_output || !get_r2r_selection(&R, &bits, &vref))
+        return;
+
+    count = collect_selected_values(values, E24_COUNT * E24_DECADES);
+    if (count == 0) {
+        for (d = 0; d < E24_DECADES; d++)
+            for (i = 0; i < E24_COUNT; i++)
+                values[count++] = E24_BASE[i] * pow(10, d);
+    }
+
+    spec.bits = bits;
+    spec.tol = get_r2r_tol();
+    spec.max_leg_parts = get_combo_id_int("combo_synth_parts", 2);
+    spec.trials = 1000;
+    spec.seed = (unsigned long)get_entry_value("entry_r2r_seed");
+
+    results = malloc(count * 3 * sizeof(LadderSynth));
+    if (!results) {
+        g_printerr("Memory allocation failed for ladder synthesis\n");
+        return;
+    }
+    t0 = g_get_monotonic_time();
+    num_results = ladder_synthesize(values, count, &spec, results, count * 3);
+    if (num_results < 0) {
+        g_printerr("Memory allocation failed for ladder synthesis\n");
+        free(results);
+        return;
+    }
+
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview_output));
+    gtk_text_buffer_set_text(buffer, "", -1);
+    gtk_text_buffer_get_end_iter(buffer, &iter);
+
+    snprintf(line, sizeof(line),
+        "\n══════════════════════════════════════════════════════════════\n"
+        "           R-2R LADDER SYNTHESIS (%d-bit, %g%% parts)\n"
+        "══════════════════════════════════════════════════════════════\n\n"
+        "  %d values tried as R, %d ladders scored in %.1f ms\n"
+        "  INL/DNL: p90 of max |error| over %ld Monte Carlo builds\n\n",
+        bits, spec.tol * 100, count, num_results,
+        (g_get_monotonic_time() - t0) / 1000.0, spec.trials);
+    gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+    /* Results are sorted by INL; list the best of each leg size */
+    for (p = 1; p <= spec.max_leg_parts; p++) {
+        snprintf(line, sizeof(line),
+            "%d-PART 2R LEGS\n"
+            "──────────────────────────────────────────────────────────────\n"
+            "  R        2R leg                       INL p90  DNL p90  Parts\n", p);
+        gtk_text_buffer_insert(buffer, &iter, line, -1);
+
+        for (i = 0, shown = 0; i < num_results && shown < SYNTH_SHOW; i++) {
+            const LadderSynth *syn = &results[i];
+            if (syn->leg_parts != p)
+                continue;
+            format_resistance(syn->R, r_str, sizeof(r_str));
+            format_synth_leg(syn, leg_str, sizeof(leg_str));
+            snprintf(line, sizeof(line), "  %-8s %-28s %7.3f  %7.3f  %5d\n",
+                     r_str, leg_str, syn->inl_p90, syn->dnl_p90, syn->parts);
+            gtk_text_buffer_insert(buffer, &iter, line, -1);
+            shown++;
+        }
+        if (shown == 0)
+            gtk_text_buffer_insert(buffer, &iter, "  (no leg of this size improves on a smaller one)\n", -1);
+        gtk_text_buffer_insert(buffer, &iter, "\n", -1);
+    }
+
+    free(results);
+}
+
+/* ========================================================================
+ * UI LOADING
+ * ======================================================================== */
+
+/*
+ * Load the UI embedded in the executable. For development,
+ * RESISTORCAL_UI names a ui.glade file to use instead, so layout
+ * changes show up without a rebuild.
+ */
+static gboolean load_ui(GtkBuilder *bldr)
+{
+    const char *override = g_getenv("RESISTORCAL_UI");
+    GError *error = NULL;
+    gint64 start = g_get_monotonic_time();
+    guint ok;
+
+    if (override && *override)
+        ok = gtk_builder_add_from_file(bldr, override, &error);
+    else
+        ok = gtk_builder_add_from_resource(bldr, UI_RESOURCE, &error);
+
+    if (!ok) {
+        g_printerr("Error: Cannot load UI from %s: %s\n",
+                   override && *override ? override : UI_RESOURCE, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    g_debug("UI loaded in %.2f ms", (g_get_monotonic_time() - start) / 1000.0);
+    return TRUE;
 }
 
 /* ========================================================================
@@ -1038,14 +1928,21 @@ static gboolean load_ui(GtkBuilder *bldr, const char *argv0)
 
 int main(int argc, char *argv[])
 {
-    GtkWidget *window, *btn, *btn_r2r;
+    GtkWidget *window, *btn, *btn_r2r, *btn_div;
+
+    /* Headless query service: no display needed */
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0)
+        return service_run(argv[2], NULL);
+    if (argc == 5 && strcmp(argv[1], "--serve") == 0 && strcmp(argv[3], "--metrics") == 0)
+        return service_run(argv[2], argv[4]);
+    if (argc > 1 && (strcmp(argv[1], "--deep") == 0 || strcmp(argv[1], "--shard-worker") == 0))
+        return shard_main(argc, argv);
 
     gtk_init(&argc, &argv);
 
     builder = gtk_builder_new();
-    if (!load_ui(builder, argv[0])) {
-        g_printerr("Error: Cannot find ui.glade\n");
-        g_printerr("Searched in: %s, current dir, data/\n", DATADIR);
+    if (!load_ui(builder)) {
+        g_object_unref(builder);
         return 1;
     }
 
@@ -1064,15 +1961,39 @@ int main(int argc, char *argv[])
     if (btn)
         g_signal_connect(btn, "clicked", G_CALLBACK(on_calculate_clicked), NULL);
 
+    /* Voltage divider button */
+    btn_div = GTK_WIDGET(gtk_builder_get_object(builder, "button_divider"));
+    if (btn_div)
+        g_signal_connect(btn_div, "clicked", G_CALLBACK(on_divider_clicked), NULL);
+
     /* R-2R Ladder: initialize dropdowns and connect button */
     init_r2r_dropdowns();
     btn_r2r = GTK_WIDGET(gtk_builder_get_object(builder, "button_r2r_generate"));
     if (btn_r2r)
         g_signal_connect(btn_r2r, "clicked", G_CALLBACK(on_r2r_generate_clicked), NULL);
+    btn_r2r = GTK_WIDGET(gtk_builder_get_object(builder, "button_r2r_export"));
+    if (btn_r2r)
+        g_signal_connect(btn_r2r, "clicked", G_CALLBACK(on_r2r_export_clicked), NULL);
+    btn_r2r = GTK_WIDGET(gtk_builder_get_object(builder, "button_r2r_cal"));
+    if (btn_r2r)
+        g_signal_connect(btn_r2r, "clicked", G_CALLBACK(on_r2r_cal_clicked), NULL);
+    btn_r2r = GTK_WIDGET(gtk_builder_get_object(builder, "button_r2r_synth"));
+    if (btn_r2r)
+        g_signal_connect(btn_r2r, "clicked", G_CALLBACK(on_r2r_synth_clicked), NULL);
+    btn_r2r = GTK_WIDGET(gtk_builder_get_object(builder, "button_r2r_segment"));
+    if (btn_r2r)
+        g_signal_connect(btn_r2r, "clicked", G_CALLBACK(on_r2r_segment_clicked), NULL);
+
+    /* Network set for the default selection, built once the first frame is drawn */
+    connect_selection_signals();
+    g_signal_connect_after(window, "draw", G_CALLBACK(on_first_draw), NULL);
 
     gtk_widget_show_all(window);
+
     gtk_main();
 
+    warmup_cancel();
+    network_cache_clear();
     g_object_unref(builder);
     return 0;
 }
@@ -0,0 +1,1966 @@
+/*
+ * service.c - Local query service over a Unix domain socket
+ *
+ * One event-loop thread owns every connection: poll() over the
+ * listening socket, the clients and a wake-up pipe. Each complete
+ * request line is queued for a pool of worker threads. A worker posts
+ * its reply back and wakes the loop through the pipe. Inventories keep
+ * their network set and sorted index between queries, so a network
+ * query is a binary search over warm data.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L   /* pthreads, sockets under -std=c99 */
+#endif
+
+#include "service.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+
+int service_run(const char *socket_path, const char *metrics_addr)
+{
+    (void)socket_path;
+    (void)metrics_addr;
+    fprintf(stderr, "--serve needs Unix domain sockets, which this build does not support\n");
+    return 1;
+}
+
+#else
+
+#include "network.h"
+#include "ladder.h"
+#include "parallel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_VALUES 256            /* values per inventory */
+#define MAX_LIMIT 1000            /* results per reply */
+#define MAX_LINE (1 << 20)        /* longest request line */
+#define MAX_CLIENTS 256
+#define MAX_INVENTORIES 16        /* warm network sets kept */
+#define MAX_WORKERS 64
+#define READ_CHUNK 65536
+
+/* ========================================================================
+ * REPLY BUFFERS
+ * ======================================================================== */
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+    int failed;                   /* an allocation failed; contents are partial */
+} Buf;
+
+static int buf_reserve(Buf *b, size_t extra)
+{
+    size_t cap;
+    char *data;
+
+    if (b->failed)
+        return -1;
+    if (b->len + extra + 1 <= b->cap)
+        return 0;
+    cap = b->cap ? b->cap : 256;
+    while (cap < b->len + extra + 1)
+        cap *= 2;
+    data = realloc(b->data, cap);
+    if (!data) {
+        b->failed = 1;
+        return -1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static void buf_append(Buf *b, const char *s, size_t n)
+{
+    if (buf_reserve(b, n) != 0)
+        return;
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+static void buf_printf(Buf *b, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0 || buf_reserve(b, (size_t)n) != 0)
+        return;
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    b->len += (size_t)n;
+}
+
+static void buf_json_string(Buf *b, const char *s)
+{
+    buf_append(b, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            buf_printf(b, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            buf_printf(b, "\\u%04x", (unsigned char)*s);
+        else
+            buf_append(b, s, 1);
+    }
+    buf_append(b, "\"", 1);
+}
+
+static void buf_free(Buf *b)
+{
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+/* ========================================================================
+ * REQUEST PARSING
+ * ======================================================================== */
+
+/* One request line; numbers stay double until used */
+typedef struct {
+    char type[16];
+    char id[64];                  /* raw JSON of "id", echoed in the reply */
+    double values[MAX_VALUES];
+    int num_values;
+    double target, tol, part_tol, ratio;
+    double min_total, max_total, max_zout, max_parts;
+    double limit, bits, R, seed;
+    int guaranteed;
+} Request;
+
+static const struct {
+    const char *key;
+    size_t offset;
+} NUMBER_FIELDS[] = {
+    { "target", offsetof(Request, target) },
+    { "tol", offsetof(Request, tol) },
+    { "part_tol", offsetof(Request, part_tol) },
+    { "ratio", offsetof(Request, ratio) },
+    { "min_total", offsetof(Request, min_total) },
+    { "max_total", offsetof(Request, max_total) },
+    { "max_zout", offsetof(Request, max_zout) },
+    { "max_parts", offsetof(Request, max_parts) },
+    { "limit", offsetof(Request, limit) },
+    { "bits", offsetof(Request, bits) },
+    { "R", offsetof(Request, R) },
+    { "seed", offsetof(Request, seed) }
+};
+
+static void skip_ws(const char **p)
+{
+    while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n')
+        (*p)++;
+}
+
+/* String into out (truncated to size); escapes other than \" \\ \/ become '?' */
+static int parse_string(const char **p, char *out, size_t size)
+{
+    size_t len = 0;
+
+    if (**p != '"')
+        return -1;
+    (*p)++;
+    while (**p && **p != '"') {
+        char c = **p;
+        if (c == '\\') {
+            (*p)++;
+            if (!**p)
+                return -1;
+            c = (**p == '"' || **p == '\\' || **p == '/') ? **p : '?';
+            if (**p == 'u') {
+                int k;
+                for (k = 0; k < 4 && (*p)[1]; k++)
+                    (*p)++;
+            }
+        }
+        if (len + 1 < size)
+            out[len++] = c;
+        (*p)++;
+    }
+    if (**p != '"')
+        return -1;
+    (*p)++;
+    if (size)
+        out[len] = '\0';
+    return 0;
+}
+
+static int parse_number(const char **p, double *out)
+{
+    char *end;
+
+    *out = strtod(*p, &end);
+    if (end == *p || !isfinite(*out))
+        return -1;
+    *p = end;
+    return 0;
+}
+
+static int skip_value(const char **p, int depth)
+{
+    char scratch[1];
+
+    skip_ws(p);
+    if (depth > 32)
+        return -1;
+    if (**p == '"')
+        return parse_string(p, scratch, 0);
+    if (**p == '[' || **p == '{') {
+        char close = **p == '[' ? ']' : '}';
+        (*p)++;
+        skip_ws(p);
+        if (**p == close) {
+            (*p)++;
+            return 0;
+        }
+        for (;;) {
+            if (close == '}') {
+                if (parse_string(p, scratch, 0) != 0)
+                    return -1;
+                skip_ws(p);
+                if (**p != ':')
+                    return -1;
+                (*p)++;
+            }
+            if (skip_value(p, depth + 1) != 0)
+                return -1;
+            skip_ws(p);
+            if (**p == close) {
+                (*p)++;
+                return 0;
+            }
+            if (**p != ',')
+                return -1;
+            (*p)++;
+            skip_ws(p);
+        }
+    }
+    if (strncmp(*p, "true", 4) == 0 || strncmp(*p, "null", 4) == 0) {
+        *p += 4;
+        return 0;
+    }
+    if (strncmp(*p, "false", 5) == 0) {
+        *p += 5;
+        return 0;
+    }
+    {
+        double d;
+        return parse_number(p, &d);
+    }
+}
+
+static int parse_values(const char **p, Request *req)
+{
+    if (**p != '[')
+        return -1;
+    (*p)++;
+    skip_ws(p);
+    if (**p == ']') {
+        (*p)++;
+        return 0;
+    }
+    for (;;) {
+        double v;
+        skip_ws(p);
+        if (parse_number(p, &v) != 0 || req->num_values >= MAX_VALUES)
+            return -1;
+        req->values[req->num_values++] = v;
+        skip_ws(p);
+        if (**p == ']') {
+            (*p)++;
+            return 0;
+        }
+        if (**p != ',')
+            return -1;
+        (*p)++;
+    }
+}
+
+/* Parse one request line. Returns 0, or -1 with *error set. */
+static int parse_request(const char *line, Request *req, const char **error)
+{
+    const char *p = line;
+
+    memset(req, 0, sizeof(*req));
+    strcpy(req->id, "null");
+    req->tol = NAN;               /* default depends on the type, see below */
+    req->part_tol = 0.01;
+    req->limit = 10;
+    req->bits = 8;
+    req->R = 10000;
+    req->seed = 1;
+
+    *error = "malformed JSON";
+    skip_ws(&p);
+    if (*p != '{')
+        return -1;
+    p++;
+    skip_ws(&p);
+    if (*p == '}')
+        p++;
+    else for (;;) {
+        char key[32];
+        size_t k;
+
+        if (parse_string(&p, key, sizeof(key)) != 0)
+            return -1;
+        skip_ws(&p);
+        if (*p != ':')
+            return -1;
+        p++;
+        skip_ws(&p);
+
+        if (strcmp(key, "id") == 0) {
+            const char *start = p;
+            if (skip_value(&p, 0) != 0)
+                return -1;
+            if ((size_t)(p - start) >= sizeof(req->id)) {
+                *error = "id too long";
+                return -1;
+            }
+            memcpy(req->id, start, p - start);
+            req->id[p - start] = '\0';
+        } else if (strcmp(key, "type") == 0) {
+            if (parse_string(&p, req->type, sizeof(req->type)) != 0)
+                return -1;
+        } else if (strcmp(key, "values") == 0) {
+            if (parse_values(&p, req) != 0) {
+                *error = "values must be an array of at most 256 numbers";
+                return -1;
+            }
+        } else if (strcmp(key, "guaranteed") == 0) {
+            req->guaranteed = strncmp(p, "true", 4) == 0;
+            if (skip_value(&p, 0) != 0)
+                return -1;
+        } else {
+            for (k = 0; k < sizeof(NUMBER_FIELDS) / sizeof(NUMBER_FIELDS[0]); k++)
+                if (strcmp(key, NUMBER_FIELDS[k].key) == 0)
+                    break;
+            if (k < sizeof(NUMBER_FIELDS) / sizeof(NUMBER_FIELDS[0])) {
+                if (parse_number(&p, (double *)((char *)req + NUMBER_FIELDS[k].offset)) != 0)
+                    return -1;
+            } else if (skip_value(&p, 0) != 0) {
+                return -1;
+            }
+        }
+
+        skip_ws(&p);
+        if (*p == '}') {
+            p++;
+            break;
+        }
+        if (*p != ',')
+            return -1;
+        p++;
+        skip_ws(&p);
+    }
+    skip_ws(&p);
+    if (*p)
+        return -1;
+    if (isnan(req->tol))
+        req->tol = strcmp(req->type, "r2r") == 0 ? 0 : 0.01;   /* r2r: ideal ladder */
+    return 0;
+}
+
+/* ========================================================================
+ * INVENTORIES
+ * ======================================================================== */
+
+enum { INVENTORY_BUILDING, INVENTORY_READY, INVENTORY_FAILED };
+
+/* Warm network set and sorted index of one value list and part tolerance */
+typedef struct Inventory {
+    struct Inventory *next;
+    uint64_t hash;
+    int count;
+    double part_tol;
+    double values[MAX_VALUES];
+    NetworkSet set;
+    NetRef *refs;                 /* every network, ascending R */
+    int num_refs;
+    int state;                    /* INVENTORY_* */
+    int users;                    /* queries holding it */
+    unsigned long last_used;
+} Inventory;
+
+static pthread_mutex_t inventory_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t inventory_built = PTHREAD_COND_INITIALIZER;
+static Inventory *inventories = NULL;
+static int num_inventories = 0;
+static unsigned long inventory_clock = 0;
+
+/* FNV-1a over the values and part tolerance */
+static uint64_t inventory_hash(const double *values, int count, double part_tol)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *bytes = (const unsigned char *)values;
+    size_t i;
+
+    for (i = 0; i < count * sizeof(double); i++)
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    bytes = (const unsigned char *)&part_tol;
+    for (i = 0; i < sizeof(double); i++)
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static void inventory_free(Inventory *inv)
+{
+    if (inv->state == INVENTORY_READY) {
+        network_set_free(&inv->set);
+        free(inv->refs);
+    }
+    free(inv);
+}
+
+/* Unlink inv from the list (lock held) */
+static void inventory_unlink(Inventory *inv)
+{
+    Inventory **pp;
+
+    for (pp = &inventories; *pp; pp = &(*pp)->next)
+        if (*pp == inv) {
+            *pp = inv->next;
+            num_inventories--;
+            return;
+        }
+}
+
+/* Drop least recently used idle inventories down to the cap (lock held) */
+static void inventory_evict(void)
+{
+    while (num_inventories >= MAX_INVENTORIES) {
+        Inventory *inv, *oldest = NULL;
+        for (inv = inventories; inv; inv = inv->next)
+            if (inv->users == 0 && (!oldest || inv->last_used < oldest->last_used))
+                oldest = inv;
+        if (!oldest)
+            return;
+        inventory_unlink(oldest);
+        inventory_free(oldest);
+    }
+}
+
+/*
+ * The ready inventory for these values, built on first use. A query that
+ * asks while another builds the same inventory waits for that build.
+ * Release with inventory_release(). NULL on allocation failure. When
+ * this call built it, *enumerated gets the number of networks.
+ */
+static Inventory *inventory_acquire(const double *values, int count, double part_tol,
+                                    long *enumerated)
+{
+    uint64_t hash = inventory_hash(values, count, part_tol);
+    Inventory *inv;
+    Part parts[MAX_VALUES];
+    int i, ok;
+
+    pthread_mutex_lock(&inventory_lock);
+    for (inv = inventories; inv; inv = inv->next)
+        if (inv->hash == hash && inv->count == count && inv->part_tol == part_tol &&
+            memcmp(inv->values, values, count * sizeof(double)) == 0 &&
+            inv->state != INVENTORY_FAILED)
+            break;
+    if (inv) {
+        inv->users++;
+        inv->last_used = ++inventory_clock;
+        while (inv->state == INVENTORY_BUILDING)
+            pthread_cond_wait(&inventory_built, &inventory_lock);
+        pthread_mutex_unlock(&inventory_lock);
+        if (inv->state == INVENTORY_READY)
+            return inv;
+        pthread_mutex_lock(&inventory_lock);
+        if (--inv->users == 0)
+            inventory_free(inv);     /* failed builds are already unlinked */
+        pthread_mutex_unlock(&inventory_lock);
+        return NULL;
+    }
+
+    inventory_evict();
+    inv = calloc(1, sizeof(Inventory));
+    if (!inv) {
+        pthread_mutex_unlock(&inventory_lock);
+        return NULL;
+    }
+    inv->hash = hash;
+    inv->count = count;
+    inv->part_tol = part_tol;
+    memcpy(inv->values, values, count * sizeof(double));
+    inv->state = INVENTORY_BUILDING;
+    inv->users = 1;
+    inv->last_used = ++inventory_clock;
+    inv->next = inventories;
+    inventories = inv;
+    num_inventories++;
+    pthread_mutex_unlock(&inventory_lock);
+
+    for (i = 0; i < count; i++) {
+        parts[i].R = values[i];
+        parts[i].tol = part_tol;
+        parts[i].tcr = 0;
+        parts[i].power = 0;
+    }
+    ok = network_set_build(&inv->set, parts, count) == 0;
+    if (ok) {
+        inv->num_refs = network_sorted_refs(&inv->set, &inv->refs);
+        if (inv->num_refs < 0) {
+            network_set_free(&inv->set);
+            ok = 0;
+        } else {
+            *enumerated = inv->num_refs;
+        }
+    }
+
+    pthread_mutex_lock(&inventory_lock);
+    inv->state = ok ? INVENTORY_READY : INVENTORY_FAILED;
+    if (!ok) {
+        inventory_unlink(inv);
+        if (--inv->users == 0)
+            inventory_free(inv);
+        inv = NULL;
+    }
+    pthread_cond_broadcast(&inventory_built);
+    pthread_mutex_unlock(&inventory_lock);
+    return inv;
+}
+
+static void inventory_release(Inventory *inv)
+{
+    pthread_mutex_lock(&inventory_lock);
+    inv->users--;
+    pthread_mutex_unlock(&inventory_lock);
+}
+
+/* Ready inventories and the bytes their sets and indexes hold */
+static void inventory_usage(int *count, size_t *bytes)
+{
+    const Inventory *inv;
+
+    *count = 0;
+    *bytes = 0;
+    pthread_mutex_lock(&inventory_lock);
+    for (inv = inventories; inv; inv = inv->next)
+        if (inv->state == INVENTORY_READY) {
+            (*count)++;
+            *bytes += sizeof(Inventory) + (size_t)MAX_N * MAX_NETWORKS * sizeof(Network) +
+                      (size_t)inv->num_refs * sizeof(NetRef);
+        }
+    pthread_mutex_unlock(&inventory_lock);
+}
+
+static void inventory_free_all(void)
+{
+    while (inventories) {
+        Inventory *inv = inventories;
+        inventories = inv->next;
+        inventory_free(inv);
+    }
+    num_inventories = 0;
+}
+
+/* ========================================================================
+ * JOBS
+ * ======================================================================== */
+
+enum { QUERY_NETWORK, QUERY_DIVIDER, QUERY_R2R, QUERY_OTHER, NUM_QUERY_TYPES };
+
+static const char *const QUERY_NAMES[NUM_QUERY_TYPES] = {
+    "network", "divider", "r2r", "other"
+};
+
+/* Everything a reply depends on, compared bytewise */
+typedef struct {
+    uint64_t inventory;           /* inventory_hash(), 0 for r2r */
+    int type;                     /* QUERY_* */
+    int guaranteed;
+    double param[12];             /* the NUMBER_FIELDS, in order */
+} QueryKey;
+
+struct CacheEntry;
+
+/* One request line from submission to delivered reply */
+typedef struct Job {
+    struct Job *next;
+    int slot;                     /* client slot */
+    unsigned gen;                 /* client generation when submitted */
+    double submitted;             /* seconds, monotonic */
+    int type;                     /* QUERY_* */
+    Request *req;
+    QueryKey key;
+    struct CacheEntry *entry;     /* in-flight cache entry this job computes */
+    Buf body;                     /* reply fields after "ok":true */
+    const char *error;            /* or the reason it failed */
+    Buf reply;                    /* full reply line */
+} Job;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void job_free(Job *job)
+{
+    free(job->req);
+    buf_free(&job->body);
+    buf_free(&job->reply);
+    free(job);
+}
+
+static int query_type(const char *type)
+{
+    int t;
+    for (t = 0; t < QUERY_OTHER; t++)
+        if (strcmp(type, QUERY_NAMES[t]) == 0)
+            return t;
+    return QUERY_OTHER;
+}
+
+static void make_key(const Request *req, int type, QueryKey *key)
+{
+    size_t k;
+
+    memset(key, 0, sizeof(*key));
+    key->type = type;
+    key->guaranteed = req->guaranteed;
+    if (type == QUERY_NETWORK || type == QUERY_DIVIDER)
+        key->inventory = inventory_hash(req->values, req->num_values, req->part_tol);
+    for (k = 0; k < sizeof(NUMBER_FIELDS) / sizeof(NUMBER_FIELDS[0]); k++)
+        key->param[k] = *(const double *)((const char *)req + NUMBER_FIELDS[k].offset);
+}
+
+/* Reply line for id from a body or an error */
+static void format_reply(Buf *reply, const char *id, const Buf *body, const char *error)
+{
+    if (error || !body || body->failed) {
+        buf_printf(reply, "{\"id\":%s,\"ok\":false,\"error\":", id);
+        buf_json_string(reply, error ? error : "out of memory");
+        buf_append(reply, "}\n", 2);
+    } else {
+        buf_printf(reply, "{\"id\":%s,\"ok\":true", id);
+        buf_append(reply, body->data ? body->data : "", body->len);
+        buf_append(reply, "}\n", 2);
+    }
+}
+
+/* ========================================================================
+ * RESULT CACHE
+ * ======================================================================== */
+
+#define CACHE_BUCKETS 4096
+#define CACHE_BYTES (16 << 20)    /* reply bodies kept */
+
+/*
+ * Reply bodies by QueryKey. An entry is created when a query misses and
+ * is in flight until its job completes: identical queries arriving
+ * meanwhile wait on it instead of computing again. Completed entries
+ * sit on an LRU list and are dropped past CACHE_BYTES. Inventories are
+ * matched by their 64-bit hash only.
+ */
+typedef struct CacheEntry {
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev, *lru_next;
+    uint64_t hash;
+    QueryKey key;
+    int ready;
+    Buf body;
+    Job *waiters;                 /* identical queries waiting on this one */
+} CacheEntry;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry *cache_buckets[CACHE_BUCKETS];
+static CacheEntry *lru_head, *lru_tail;   /* most recently used first */
+static size_t cache_bytes = 0;
+static int cache_entries = 0;
+
+static uint64_t key_hash(const QueryKey *key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *bytes = (const unsigned char *)key;
+    size_t i;
+
+    for (i = 0; i < sizeof(*key); i++)
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static void lru_unlink(CacheEntry *e)
+{
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push_front(CacheEntry *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = e;
+    else lru_tail = e;
+    lru_head = e;
+}
+
+/* Remove e from its bucket and free it (lock held, no waiters) */
+static void cache_remove(CacheEntry *e)
+{
+    CacheEntry **pp = &cache_buckets[e->hash % CACHE_BUCKETS];
+
+    while (*pp != e)
+        pp = &(*pp)->bucket_next;
+    *pp = e->bucket_next;
+    if (e->ready) {
+        lru_unlink(e);
+        cache_bytes -= e->body.cap;
+    }
+    cache_entries--;
+    buf_free(&e->body);
+    free(e);
+}
+
+enum { CACHE_MISS, CACHE_HIT, CACHE_COALESCED };
+
+/*
+ * Look job up. On a hit its reply is formatted from the cached body; on
+ * a coalesced lookup the job now waits on the in-flight entry; on a miss
+ * the job owns a new in-flight entry (job->entry, NULL if out of memory)
+ * and must be computed.
+ */
+static int cache_lookup(Job *job)
+{
+    uint64_t hash = key_hash(&job->key);
+    CacheEntry *e;
+
+    pthread_mutex_lock(&cache_lock);
+    for (e = cache_buckets[hash % CACHE_BUCKETS]; e; e = e->bucket_next)
+        if (e->hash == hash && memcmp(&e->key, &job->key, sizeof(QueryKey)) == 0)
+            break;
+    if (e && e->ready) {
+        lru_unlink(e);
+        lru_push_front(e);
+        format_reply(&job->reply, job->req->id, &e->body, NULL);
+        pthread_mutex_unlock(&cache_lock);
+        return CACHE_HIT;
+    }
+    if (e) {
+        job->next = e->waiters;
+        e->waiters = job;
+        pthread_mutex_unlock(&cache_lock);
+        return CACHE_COALESCED;
+    }
+    e = calloc(1, sizeof(CacheEntry));
+    if (e) {
+        e->hash = hash;
+        e->key = job->key;
+        e->bucket_next = cache_buckets[hash % CACHE_BUCKETS];
+        cache_buckets[hash % CACHE_BUCKETS] = e;
+        cache_entries++;
+    }
+    job->entry = e;
+    pthread_mutex_unlock(&cache_lock);
+    return CACHE_MISS;
+}
+
+/*
+ * Finish a computed job: format its reply and those of its waiters, and
+ * keep the body if it succeeded. Returns the waiters, linked by next.
+ */
+static Job *cache_complete(Job *job)
+{
+    CacheEntry *e = job->entry;
+    int failed = job->error || job->body.failed;
+    Job *waiters = NULL, *w;
+
+    format_reply(&job->reply, job->req->id, &job->body, job->error);
+    if (!e)
+        return NULL;
+
+    pthread_mutex_lock(&cache_lock);
+    waiters = e->waiters;
+    e->waiters = NULL;
+    for (w = waiters; w; w = w->next)
+        format_reply(&w->reply, w->req->id, &job->body, job->error);
+    if (failed) {
+        cache_remove(e);
+    } else {
+        e->body = job->body;
+        memset(&job->body, 0, sizeof(Buf));
+        e->ready = 1;
+        cache_bytes += e->body.cap;
+        lru_push_front(e);
+        while (cache_bytes > CACHE_BYTES && lru_tail != e)
+            cache_remove(lru_tail);
+    }
+    job->entry = NULL;
+    pthread_mutex_unlock(&cache_lock);
+    return waiters;
+}
+
+static void cache_free_all(void)
+{
+    int b;
+
+    for (b = 0; b < CACHE_BUCKETS; b++)
+        while (cache_buckets[b]) {
+            CacheEntry *e = cache_buckets[b];
+            while (e->waiters) {
+                Job *w = e->waiters;
+                e->waiters = w->next;
+                job_free(w);
+            }
+            cache_buckets[b] = e->bucket_next;
+            buf_free(&e->body);
+            free(e);
+        }
+    lru_head = lru_tail = NULL;
+    cache_bytes = 0;
+    cache_entries = 0;
+}
+
+/* ========================================================================
+ * QUERIES
+ * ======================================================================== */
+
+#define BATCH_MAX 64              /* network queries answered in one pass */
+#define BATCH_SCAN 256            /* queued jobs looked at to fill a batch */
+
+typedef struct {
+    double error;
+    int n, i;
+} Match;
+
+typedef struct {
+    Match *match;
+    int count, cap;
+} MatchList;
+
+/* One network query of a batch: its index window and the exact test */
+typedef struct {
+    double lo, hi;
+    SearchSpec spec;
+    int job;                      /* index into the batch */
+} Window;
+
+static int compare_matches(const void *a, const void *b)
+{
+    const Match *ma = (const Match *)a;
+    const Match *mb = (const Match *)b;
+    if (ma->error < mb->error) return -1;
+    if (ma->error > mb->error) return 1;
+    return ma->n - mb->n;
+}
+
+static int compare_windows(const void *a, const void *b)
+{
+    const Window *wa = (const Window *)a;
+    const Window *wb = (const Window *)b;
+    return (wa->lo > wb->lo) - (wa->lo < wb->lo);
+}
+
+/* First index in [from, count) of the sorted refs with R >= r */
+static int refs_lower_bound(const NetRef *refs, int from, int count, double r)
+{
+    int lo = from, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (refs[mid].R < r)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Clamped while still a double: client numbers may be out of int range */
+static int limit_of(const Request *req)
+{
+    if (!(req->limit >= 1)) return 1;
+    if (req->limit > MAX_LIMIT) return MAX_LIMIT;
+    return (int)req->limit;
+}
+
+static int match_push(MatchList *list, double error, int n, int i)
+{
+    if (list->count == list->cap) {
+        int cap = list->cap ? list->cap * 2 : 64;
+        Match *match = realloc(list->match, cap * sizeof(Match));
+        if (!match)
+            return -1;
+        list->match = match;
+        list->cap = cap;
+    }
+    list->match[list->count].error = error;
+    list->match[list->count].n = n;
+    list->match[list->count].i = i;
+    list->count++;
+    return 0;
+}
+
+/*
+ * Network queries of one inventory in a single sweep over its sorted
+ * index. Windows are taken in order of their lower edge; each index
+ * entry is tested against the windows open at its R, and gaps between
+ * windows are skipped by binary search. network_matches() applies the
+ * exact test, so the windows only need to cover every candidate.
+ */
+static void query_networks(const Inventory *inv, Job **batch, int count)
+{
+    Window win[BATCH_MAX];
+    MatchList lists[BATCH_MAX];
+    int active[BATCH_MAX];
+    int num_win = 0, num_active = 0, next = 0, b, k, m;
+
+    memset(lists, 0, sizeof(lists));
+    for (b = 0; b < count; b++) {
+        const Request *req = batch[b]->req;
+        if (req->target <= 0 || req->tol < 0) {
+            batch[b]->error = "target must be positive and tol non-negative";
+            continue;
+        }
+        win[num_win].lo = req->target * (1.0 - req->tol) * (1.0 - 1e-12);
+        win[num_win].hi = req->target * (1.0 + req->tol) * (1.0 + 1e-12);
+        memset(&win[num_win].spec, 0, sizeof(SearchSpec));
+        win[num_win].spec.target = req->target;
+        win[num_win].spec.tol = req->tol;
+        win[num_win].spec.guaranteed = req->guaranteed;
+        win[num_win].spec.op_mode = OPERATING_NONE;
+        win[num_win].job = b;
+        num_win++;
+    }
+    qsort(win, num_win, sizeof(Window), compare_windows);
+
+    k = num_win ? refs_lower_bound(inv->refs, 0, inv->num_refs, win[0].lo) : inv->num_refs;
+    while (k < inv->num_refs) {
+        const NetRef *ref = &inv->refs[k];
+        const Network *net;
+        int kept = 0;
+
+        while (next < num_win && win[next].lo <= ref->R)
+            active[num_active++] = next++;
+        for (m = 0; m < num_active; m++)
+            if (win[active[m]].hi >= ref->R)
+                active[kept++] = active[m];
+        num_active = kept;
+        if (num_active == 0) {
+            if (next == num_win)
+                break;
+            k = refs_lower_bound(inv->refs, k + 1, inv->num_refs, win[next].lo);
+            continue;
+        }
+
+        net = &inv->set.level[ref->n][ref->i];
+        for (m = 0; m < num_active; m++) {
+            const Window *w = &win[active[m]];
+            if (network_matches(net, &w->spec) &&
+                match_push(&lists[w->job], fabs(ref->R - w->spec.target) / w->spec.target,
+                           ref->n, ref->i) != 0)
+                batch[w->job]->error = "out of memory";
+        }
+        k++;
+    }
+
+    for (b = 0; b < count; b++) {
+        Job *job = batch[b];
+        MatchList *list = &lists[b];
+        int limit = limit_of(job->req);
+
+        if (!job->error) {
+            if (list->count > 1)
+                qsort(list->match, list->count, sizeof(Match), compare_matches);
+            buf_printf(&job->body, ",\"total\":%d%s,\"results\":[", list->count,
+                       inv->set.truncated ? ",\"truncated\":true" : "");
+            for (k = 0; k < list->count && k < limit; k++) {
+                const Network *net = &inv->set.level[list->match[k].n][list->match[k].i];
+                buf_printf(&job->body, "%s{\"expr\":", k ? "," : "");
+                buf_json_string(&job->body, net->expr);
+                buf_printf(&job->body, ",\"R\":%.12g,\"error\":%.6g,\"n\":%d,\"R_lo\":%.12g,\"R_hi\":%.12g}",
+                           net->R, list->match[k].error, net->n, net->R_lo, net->R_hi);
+            }
+            buf_append(&job->body, "]", 1);
+        }
+        free(list->match);
+    }
+}
+
+static const char *query_divider(const Inventory *inv, const Request *req, Buf *out)
+{
+    DividerSpec spec;
+    DividerResult *results;
+    int k, count, limit = limit_of(req);
+
+    if (req->ratio <= 0 || req->ratio >= 1)
+        return "ratio must be between 0 and 1";
+    if (req->max_parts < 0)
+        return "max_parts must be non-negative";
+
+    spec.ratio = req->ratio;
+    spec.tol = req->tol;
+    spec.min_total = req->min_total;
+    spec.max_total = req->max_total;
+    spec.max_zout = req->max_zout;
+    spec.max_parts = req->max_parts < 2 * MAX_N ? (int)req->max_parts : 0;   /* 0 = any */
+
+    results = malloc(limit * sizeof(DividerResult));
+    if (!results)
+        return "out of memory";
+    count = divider_search_refs(inv->refs, inv->num_refs, &spec, results, limit);
+    if (count < 0) {
+        free(results);
+        return "out of memory";
+    }
+
+    buf_printf(out, ",\"total\":%d%s,\"results\":[", count,
+               inv->set.truncated ? ",\"truncated\":true" : "");
+    for (k = 0; k < count; k++) {
+        const DividerResult *d = &results[k];
+        buf_printf(out, "%s{\"top\":", k ? "," : "");
+        buf_json_string(out, inv->set.level[d->top_n][d->top_i].expr);
+        buf_append(out, ",\"bottom\":", 10);
+        buf_json_string(out, inv->set.level[d->bot_n][d->bot_i].expr);
+        buf_printf(out, ",\"Rtop\":%.12g,\"Rbot\":%.12g,\"ratio\":%.12g,\"error\":%.6g,"
+                   "\"total\":%.12g,\"zout\":%.12g,\"n\":%d}",
+                   d->Rtop, d->Rbot, d->ratio, d->error, d->total, d->zout, d->n);
+    }
+    buf_append(out, "]", 1);
+    free(results);
+    return NULL;
+}
+
+/* Full-code linearity of a nominal or tolerance-sampled ladder */
+static const char *query_r2r(const Request *req, Buf *out)
+{
+    Ladder lad;
+    LadderLinearity lin;
+    int bits;
+
+    if (!(req->bits >= 2 && req->bits < MAX_R2R_BITS + 1) || req->R <= 0 || req->tol < 0)
+        return "bits must be 2-24, R positive and tol non-negative";
+    if (!(req->seed >= 0 && req->seed < (double)ULONG_MAX))
+        return "seed must be non-negative";
+    bits = (int)req->bits;
+
+    if (req->tol > 0)
+        ladder_sample(&lad, bits, req->R, req->tol, (unsigned long)req->seed);
+    else
+        ladder_init_ideal(&lad, bits, req->R);
+    if (ladder_linearity(&lad, &lin) != 0)
+        return "out of memory";
+
+    buf_printf(out, ",\"bits\":%d,\"inl_max\":%.6g,\"inl_min\":%.6g,\"dnl_max\":%.6g,"
+               "\"dnl_min\":%.6g,\"non_monotonic\":%ld,\"full_scale\":%.12g,\"gain_error\":%.6g",
+               bits, lin.inl_max, lin.inl_min, lin.dnl_max, lin.dnl_min,
+               lin.non_monotonic, lin.full_scale, lin.gain_error);
+    return NULL;
+}
+
+/* Fill body or error of every job of a batch (network batches share an inventory) */
+static void process_batch(Job **batch, int count, long *enumerated)
+{
+    const Request *req = batch[0]->req;
+    Inventory *inv;
+    int b;
+
+    if (batch[0]->type == QUERY_R2R) {
+        batch[0]->error = query_r2r(req, &batch[0]->body);
+        return;
+    }
+    if (batch[0]->type == QUERY_OTHER) {
+        batch[0]->error = "type must be network, divider, r2r or stats";
+        return;
+    }
+
+    if (req->num_values == 0)
+        batch[0]->error = "values is required";
+    else if (req->part_tol < 0 || req->part_tol >= 1)
+        batch[0]->error = "part_tol must be in [0, 1)";
+    else if (!(inv = inventory_acquire(req->values, req->num_values, req->part_tol,
+                                        enumerated)))
+        batch[0]->error = "out of memory";
+    else {
+        if (batch[0]->type == QUERY_NETWORK)
+            query_networks(inv, batch, count);
+        else
+            batch[0]->error = query_divider(inv, req, &batch[0]->body);
+        inventory_release(inv);
+        return;
+    }
+    for (b = 1; b < count; b++)
+        batch[b]->error = batch[0]->error;
+}
+
+/* ========================================================================
+ * WORKER POOL
+ * ======================================================================== */
+
+typedef struct {
+    Job *head, *tail;
+} JobQueue;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static JobQueue pending_jobs;     /* waiting for a worker */
+static JobQueue finished_jobs;    /* replies waiting for the event loop */
+static int pool_queued = 0;       /* jobs in pending_jobs */
+static int pool_busy = 0;         /* workers computing */
+static int pool_workers = 0;
+static int pool_stopping = 0;
+static int wake_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t stop_requested = 0;
+
+static void queue_push(JobQueue *q, Job *job)
+{
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+}
+
+static Job *queue_pop(JobQueue *q)
+{
+    Job *job = q->head;
+    if (job) {
+        q->head = job->next;
+        if (!q->head)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+static int same_inventory(const Request *a, const Request *b)
+{
+    return a->num_values == b->num_values && a->part_tol == b->part_tol &&
+           memcmp(a->values, b->values, a->num_values * sizeof(double)) == 0;
+}
+
+/*
+ * Take the next job, plus the other queued network queries of the same
+ * inventory among the next BATCH_SCAN (pool lock held). Returns the
+ * batch size.
+ */
+static int take_batch(Job **batch)
+{
+    Job *first = queue_pop(&pending_jobs), *prev = NULL, *job;
+    int count = 1, scanned = 0;
+
+    batch[0] = first;
+    if (first->type != QUERY_NETWORK)
+        return 1;
+    job = pending_jobs.head;
+    while (job && count < BATCH_MAX && scanned++ < BATCH_SCAN) {
+        Job *next = job->next;
+        if (job->type == QUERY_NETWORK && job->key.inventory == first->key.inventory &&
+            same_inventory(job->req, first->req)) {
+            if (prev)
+                prev->next = next;
+            else
+                pending_jobs.head = next;
+            if (pending_jobs.tail == job)
+                pending_jobs.tail = prev;
+            batch[count++] = job;
+        } else {
+            prev = job;
+        }
+        job = next;
+    }
+    return count;
+}
+
+/*
+ * Counters of one worker. Only that worker writes them, once per batch,
+ * so the lock is uncontended until a scrape sums them.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    long computed;                /* queries computed (not cache hits) */
+    long batches, batched;        /* passes answering several queries, and those queries */
+    long builds, enumerated;      /* inventories built, networks they hold */
+    double busy;                  /* seconds spent computing */
+} WorkerCounters;
+
+static WorkerCounters worker_counters[MAX_WORKERS];
+
+/* Wake the event loop; a full pipe already guarantees a wake-up */
+static void wake_loop(void)
+{
+    char c = 1;
+    ssize_t r = write(wake_pipe[1], &c, 1);
+    (void)r;
+}
+
+static void *worker_main(void *arg)
+{
+    WorkerCounters *counters = (WorkerCounters *)arg;
+
+    /* The pool is already one thread per CPU: engines run serially in it */
+    parallel_set_serial(1);
+
+    for (;;) {
+        Job *batch[BATCH_MAX];
+        long enumerated = 0;
+        double start;
+        int count, b;
+
+        pthread_mutex_lock(&pool_lock);
+        while (!pending_jobs.head && !pool_stopping)
+            pthread_cond_wait(&pool_work, &pool_lock);
+        if (pool_stopping) {
+            pthread_mutex_unlock(&pool_lock);
+            return NULL;
+        }
+        count = take_batch(batch);
+        pool_queued -= count;
+        pool_busy++;
+        pthread_mutex_unlock(&pool_lock);
+
+        start = now_seconds();
+        process_batch(batch, count, &enumerated);
+
+        pthread_mutex_lock(&counters->lock);
+        counters->computed += count;
+        if (count > 1) {
+            counters->batches++;
+            counters->batched += count;
+        }
+        if (enumerated) {
+            counters->builds++;
+            counters->enumerated += enumerated;
+        }
+        counters->busy += now_seconds() - start;
+        pthread_mutex_unlock(&counters->lock);
+
+        for (b = 0; b < count; b++) {
+            Job *waiters = cache_complete(batch[b]);
+            pthread_mutex_lock(&pool_lock);
+            queue_push(&finished_jobs, batch[b]);
+            while (waiters) {
+                Job *next = waiters->next;
+                queue_push(&finished_jobs, waiters);
+                waiters = next;
+            }
+            pthread_mutex_unlock(&pool_lock);
+        }
+        pthread_mutex_lock(&pool_lock);
+        pool_busy--;
+        pthread_mutex_unlock(&pool_lock);
+        wake_loop();
+    }
+}
+
+/* ========================================================================
+ * STATISTICS
+ * ======================================================================== */
+
+#define LATENCY_BUCKETS 24        /* upper bounds 1 us .. 2^23 us, then +Inf */
+
+/* Kept by the event loop thread only */
+static struct {
+    long requests;
+    long hits, coalesced, misses;
+    long latency[NUM_QUERY_TYPES][LATENCY_BUCKETS + 1];
+    double latency_sum[NUM_QUERY_TYPES];   /* seconds */
+} stats;
+
+static void record_latency(int type, double seconds)
+{
+    double us = seconds * 1e6;
+    int b = 0;
+
+    while (b < LATENCY_BUCKETS && us > (double)(1L << b))
+        b++;
+    stats.latency[type][b]++;
+    stats.latency_sum[type] += seconds;
+}
+
+/* Sum of every worker's counters */
+static void worker_totals(WorkerCounters *sum)
+{
+    int w;
+
+    memset(sum, 0, sizeof(*sum));
+    for (w = 0; w < MAX_WORKERS; w++) {
+        WorkerCounters *c = &worker_counters[w];
+        pthread_mutex_lock(&c->lock);
+        sum->computed += c->computed;
+        sum->batches += c->batches;
+        sum->batched += c->batched;
+        sum->builds += c->builds;
+        sum->enumerated += c->enumerated;
+        sum->busy += c->busy;
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+static void format_stats(Buf *body)
+{
+    long lookups = stats.hits + stats.coalesced + stats.misses;
+    WorkerCounters workers;
+    size_t bytes;
+    int entries, t, b;
+
+    worker_totals(&workers);
+    pthread_mutex_lock(&cache_lock);
+    bytes = cache_bytes;
+    entries = cache_entries;
+    pthread_mutex_unlock(&cache_lock);
+
+    buf_printf(body, ",\"requests\":%ld,\"cache\":{\"hits\":%ld,\"coalesced\":%ld,\"misses\":%ld,"
+               "\"hit_rate\":%.4f,\"entries\":%d,\"bytes\":%lu},\"batches\":%ld,\"batched\":%ld,"
+               "\"latency_us\":{\"le\":[",
+               stats.requests, stats.hits, stats.coalesced, stats.misses,
+               lookups ? (double)(stats.hits + stats.coalesced) / lookups : 0.0,
+               entries, (unsigned long)bytes, workers.batches, workers.batched);
+    for (b = 0; b < LATENCY_BUCKETS; b++)
+        buf_printf(body, "%s%ld", b ? "," : "", 1L << b);
+    buf_append(body, ",null]", 6);
+    for (t = 0; t < NUM_QUERY_TYPES; t++) {
+        buf_printf(body, ",\"%s\":[", QUERY_NAMES[t]);
+        for (b = 0; b <= LATENCY_BUCKETS; b++)
+            buf_printf(body, "%s%ld", b ? "," : "", stats.latency[t][b]);
+        buf_append(body, "]", 1);
+    }
+    buf_append(body, "}", 1);
+}
+
+/* ========================================================================
+ * METRICS
+ * ======================================================================== */
+
+#define MAX_HTTP_REQUEST 8192
+
+/*
+ * Latency percentile q estimated from a log2 histogram, interpolating
+ * inside the bucket that holds it. Seconds.
+ */
+static double latency_quantile(const long *hist, long count, double q)
+{
+    long rank = (long)ceil(q * count), seen = 0;
+    int b;
+
+    if (count == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        if (seen + hist[b] >= rank) {
+            double lo = b ? (double)(1L << (b - 1)) : 0, hi = (double)(1L << b);
+            return (lo + (hi - lo) * (rank - seen) / hist[b]) * 1e-6;
+        }
+        seen += hist[b];
+    }
+    return (double)(1L << (LATENCY_BUCKETS - 1)) * 1e-6;
+}
+
+static void metric_header(Buf *out, const char *name, const char *type, const char *help)
+{
+    buf_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* Everything in the Prometheus text exposition format */
+static void format_metrics(Buf *out, int connections)
+{
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+    WorkerCounters workers;
+    long lookups = stats.hits + stats.coalesced + stats.misses;
+    int queued, busy, num_workers, entries, inventories, t, b, q;
+    size_t cache_size, inventory_bytes;
+
+    worker_totals(&workers);
+    pthread_mutex_lock(&pool_lock);
+    queued = pool_queued;
+    busy = pool_busy;
+    num_workers = pool_workers;
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_lock(&cache_lock);
+    cache_size = cache_bytes;
+    entries = cache_entries;
+    pthread_mutex_unlock(&cache_lock);
+    inventory_usage(&inventories, &inventory_bytes);
+
+    metric_header(out, "resistorcal_requests_total", "counter", "Replies sent, by query type.");
+    for (t = 0; t < NUM_QUERY_TYPES; t++) {
+        long count = 0;
+        for (b = 0; b <= LATENCY_BUCKETS; b++)
+            count += stats.latency[t][b];
+        buf_printf(out, "resistorcal_requests_total{type=\"%s\"} %ld\n", QUERY_NAMES[t], count);
+    }
+
+    metric_header(out, "resistorcal_request_duration_seconds", "histogram",
+                  "Time from reading a request to queueing its reply.");
+    for (t = 0; t < NUM_QUERY_TYPES; t++) {
+        long cumulative = 0;
+        for (b = 0; b < LATENCY_BUCKETS; b++) {
+            cumulative += stats.latency[t][b];
+            buf_printf(out, "resistorcal_request_duration_seconds_bucket{type=\"%s\",le=\"%g\"} %ld\n",
+                       QUERY_NAMES[t], (double)(1L << b) * 1e-6, cumulative);
+        }
+        cumulative += stats.latency[t][LATENCY_BUCKETS];
+        buf_printf(out, "resistorcal_request_duration_seconds_bucket{type=\"%s\",le=\"+Inf\"} %ld\n"
+                   "resistorcal_request_duration_seconds_sum{type=\"%s\"} %.9g\n"
+                   "resistorcal_request_duration_seconds_count{type=\"%s\"} %ld\n",
+                   QUERY_NAMES[t], cumulative, QUERY_NAMES[t], stats.latency_sum[t],
+                   QUERY_NAMES[t], cumulative);
+    }
+
+    metric_header(out, "resistorcal_request_duration_quantile_seconds", "gauge",
+                  "Latency percentiles since start, estimated from the histogram.");
+    for (t = 0; t < NUM_QUERY_TYPES; t++) {
+        long count = 0;
+        for (b = 0; b <= LATENCY_BUCKETS; b++)
+            count += stats.latency[t][b];
+        for (q = 0; q < (int)(sizeof(QUANTILES) / sizeof(QUANTILES[0])); q++)
+            buf_printf(out, "resistorcal_request_duration_quantile_seconds{type=\"%s\",quantile=\"%g\"} %.9g\n",
+                       QUERY_NAMES[t], QUANTILES[q],
+                       latency_quantile(stats.latency[t], count, QUANTILES[q]));
+    }
+
+    metric_header(out, "resistorcal_cache_lookups_total", "counter",
+                  "Result cache lookups: answered, joined an identical query in flight, or computed.");
+    buf_printf(out, "resistorcal_cache_lookups_total{result=\"hit\"} %ld\n"
+               "resistorcal_cache_lookups_total{result=\"coalesced\"} %ld\n"
+               "resistorcal_cache_lookups_total{result=\"miss\"} %ld\n",
+               stats.hits, stats.coalesced, stats.misses);
+    metric_header(out, "resistorcal_cache_hit_ratio", "gauge",
+                  "Share of lookups not computed again, since start.");
+    buf_printf(out, "resistorcal_cache_hit_ratio %.6g\n",
+               lookups ? (double)(stats.hits + stats.coalesced) / lookups : 0.0);
+    metric_header(out, "resistorcal_cache_entries", "gauge", "Cached and in-flight results.");
+    buf_printf(out, "resistorcal_cache_entries %d\n", entries);
+    metric_header(out, "resistorcal_cache_bytes", "gauge", "Memory held by cached reply bodies.");
+    buf_printf(out, "resistorcal_cache_bytes %lu\n", (unsigned long)cache_size);
+
+    metric_header(out, "resistorcal_inventory_builds_total", "counter", "Network sets enumerated.");
+    buf_printf(out, "resistorcal_inventory_builds_total %ld\n", workers.builds);
+    metric_header(out, "resistorcal_networks_enumerated_total", "counter",
+                  "Networks produced by those builds.");
+    buf_printf(out, "resistorcal_networks_enumerated_total %ld\n", workers.enumerated);
+    metric_header(out, "resistorcal_inventories", "gauge", "Network sets kept warm.");
+    buf_printf(out, "resistorcal_inventories %d\n", inventories);
+    metric_header(out, "resistorcal_inventory_bytes", "gauge",
+                  "Memory held by warm network sets and their sorted indexes.");
+    buf_printf(out, "resistorcal_inventory_bytes %lu\n", (unsigned long)inventory_bytes);
+
+    metric_header(out, "resistorcal_queries_computed_total", "counter", "Queries run by the workers.");
+    buf_printf(out, "resistorcal_queries_computed_total %ld\n", workers.computed);
+    metric_header(out, "resistorcal_batches_total", "counter",
+                  "Index passes that answered more than one network query.");
+    buf_printf(out, "resistorcal_batches_total %ld\n", workers.batches);
+    metric_header(out, "resistorcal_batched_queries_total", "counter", "Queries answered by those passes.");
+    buf_printf(out, "resistorcal_batched_queries_total %ld\n", workers.batched);
+    metric_header(out, "resistorcal_worker_busy_seconds_total", "counter", "Time workers spent computing.");
+    buf_printf(out, "resistorcal_worker_busy_seconds_total %.9g\n", workers.busy);
+    metric_header(out, "resistorcal_workers", "gauge", "Worker threads.");
+    buf_printf(out, "resistorcal_workers %d\n", num_workers);
+    metric_header(out, "resistorcal_workers_busy", "gauge", "Workers computing right now.");
+    buf_printf(out, "resistorcal_workers_busy %d\n", busy);
+    metric_header(out, "resistorcal_queue_depth", "gauge", "Queries waiting for a worker.");
+    buf_printf(out, "resistorcal_queue_depth %d\n", queued);
+    metric_header(out, "resistorcal_connections", "gauge", "Open query connections.");
+    buf_printf(out, "resistorcal_connections %d\n", connections);
+}
+
+/* ========================================================================
+ * EVENT LOOP
+ * ======================================================================== */
+
+typedef struct {
+    int fd;                       /* -1: free slot */
+    unsigned gen;                 /* bumped on close, so late replies are dropped */
+    char *in;
+    size_t in_len, in_cap;
+    Buf out;
+    size_t out_off;               /* bytes of out already written */
+    int pending;                  /* requests queued, computing or coalesced */
+    int eof;                      /* no more input; close once drained */
+    int http;                     /* a metrics scrape, not a query connection */
+} Client;
+
+static Client clients[MAX_CLIENTS];
+
+static void on_stop_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+    wake_loop();
+}
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void client_close(Client *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    c->gen++;
+    free(c->in);
+    c->in = NULL;
+    c->in_len = c->in_cap = 0;
+    buf_free(&c->out);
+    c->out_off = 0;
+    c->pending = 0;
+    c->eof = 0;
+    c->http = 0;
+}
+
+static void client_write(Client *c)
+{
+    while (c->out_off < c->out.len) {
+        ssize_t n = write(c->fd, c->out.data + c->out_off, c->out.len - c->out_off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                c->eof = 1;          /* peer gone: drop what is left */
+                c->out_off = c->out.len;
+            }
+            break;
+        }
+        c->out_off += (size_t)n;
+    }
+    if (c->out_off == c->out.len) {
+        c->out.len = 0;
+        c->out_off = 0;
+    }
+}
+
+/* Queue a reply formatted on the loop thread and record its latency */
+static void client_reply(Client *c, Job *job)
+{
+    buf_append(&c->out, job->reply.data ? job->reply.data : "", job->reply.len);
+    record_latency(job->type, now_seconds() - job->submitted);
+    job_free(job);
+}
+
+/*
+ * Parse one request line and answer it from the cache, attach it to an
+ * identical query in flight, or queue it for the workers.
+ */
+static void client_submit(int slot, const char *line)
+{
+    Client *c = &clients[slot];
+    Job *job = calloc(1, sizeof(Job));
+    const char *error;
+
+    if (job)
+        job->req = malloc(sizeof(Request));
+    if (!job || !job->req) {
+        free(job);
+        buf_printf(&c->out, "{\"id\":null,\"ok\":false,\"error\":\"out of memory\"}\n");
+        return;
+    }
+    job->slot = slot;
+    job->gen = c->gen;
+    job->submitted = now_seconds();
+    job->type = QUERY_OTHER;
+    stats.requests++;
+
+    if (parse_request(line, job->req, &error) != 0) {
+        format_reply(&job->reply, job->req->id, NULL, error);
+        client_reply(c, job);
+        return;
+    }
+    if (strcmp(job->req->type, "stats") == 0) {
+        Buf body = { NULL, 0, 0, 0 };
+        format_stats(&body);
+        format_reply(&job->reply, job->req->id, &body, NULL);
+        buf_free(&body);
+        client_reply(c, job);
+        return;
+    }
+    job->type = query_type(job->req->type);
+    make_key(job->req, job->type, &job->key);
+
+    switch (cache_lookup(job)) {
+    case CACHE_HIT:
+        stats.hits++;
+        client_reply(c, job);
+        return;
+    case CACHE_COALESCED:
+        stats.coalesced++;
+        c->pending++;
+        return;
+    default:
+        stats.misses++;
+        c->pending++;
+        pthread_mutex_lock(&pool_lock);
+        queue_push(&pending_jobs, job);
+        pool_queued++;
+        pthread_cond_signal(&pool_work);
+        pthread_mutex_unlock(&pool_lock);
+    }
+}
+
+/*
+ * Answer a scrape once its request head is in: any GET gets the
+ * metrics, since this listener serves nothing else.
+ */
+static void http_respond(Client *c)
+{
+    Buf body = { NULL, 0, 0, 0 };
+    size_t k;
+    int complete = c->eof || c->in_len >= MAX_HTTP_REQUEST, connections = 0;
+
+    for (k = 1; k < c->in_len && !complete; k++)
+        complete = c->in[k] == '\n' && (c->in[k - 1] == '\n' ||
+                                        (k >= 2 && c->in[k - 1] == '\r' && c->in[k - 2] == '\n'));
+    if (!complete)
+        return;
+
+    if (c->in_len >= 4 && memcmp(c->in, "GET ", 4) == 0) {
+        for (k = 0; k < MAX_CLIENTS; k++)
+            if (clients[k].fd >= 0 && !clients[k].http)
+                connections++;
+        format_metrics(&body, connections);
+        buf_printf(&c->out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.len);
+        buf_append(&c->out, body.data ? body.data : "", body.len);
+        buf_free(&body);
+    } else {
+        buf_printf(&c->out, "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\n"
+                   "Connection: close\r\n\r\n");
+    }
+    c->in_len = 0;
+    c->eof = 1;
+}
+
+/* Read what is available and submit every complete line */
+static void client_read(int slot)
+{
+    Client *c = &clients[slot];
+    size_t start = 0, k;
+
+    for (;;) {
+        ssize_t n;
+        if (c->in_cap - c->in_len < READ_CHUNK) {
+            char *in = realloc(c->in, c->in_cap + READ_CHUNK);
+            if (!in) {
+                c->eof = 1;
+                return;
+            }
+            c->in = in;
+            c->in_cap += READ_CHUNK;
+        }
+        n = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            if (c->in_len < MAX_LINE)
+                continue;
+            break;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            c->eof = 1;
+        if (n < 0 && errno == EINTR)
+            continue;
+        break;
+    }
+
+    if (c->http) {
+        http_respond(c);
+        return;
+    }
+    for (k = 0; k < c->in_len; k++) {
+        if (c->in[k] != '\n')
+            continue;
+        c->in[k] = '\0';
+        if (k > start)
+            client_submit(slot, c->in + start);
+        start = k + 1;
+    }
+    memmove(c->in, c->in + start, c->in_len - start);
+    c->in_len -= start;
+
+    if (c->in_len >= MAX_LINE) {
+        buf_printf(&c->out, "{\"id\":null,\"ok\":false,\"error\":\"request line too long\"}\n");
+        c->in_len = 0;
+        c->eof = 1;
+    }
+}
+
+/* Hand finished replies to their clients */
+static void deliver_replies(void)
+{
+    Job *job;
+
+    pthread_mutex_lock(&pool_lock);
+    job = finished_jobs.head;
+    finished_jobs.head = finished_jobs.tail = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    while (job) {
+        Job *next = job->next;
+        Client *c = &clients[job->slot];
+        if (c->fd >= 0 && c->gen == job->gen) {
+            c->pending--;
+            client_reply(c, job);
+            client_write(c);
+            if (c->eof && c->pending == 0 && c->out.len == c->out_off)
+                client_close(c);
+        } else {
+            job_free(job);
+        }
+        job = next;
+    }
+}
+
+static void accept_clients(int listen_fd, int http)
+{
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL), slot;
+        if (fd < 0)
+            return;
+        for (slot = 0; slot < MAX_CLIENTS && clients[slot].fd >= 0; slot++)
+            ;
+        if (slot == MAX_CLIENTS || set_nonblocking(fd) != 0) {
+            close(fd);
+            continue;
+        }
+        clients[slot].fd = fd;
+        clients[slot].http = http;
+    }
+}
+
+static int open_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    /* Replace a stale socket from an earlier run, never another file */
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 64) != 0 || set_nonblocking(fd) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Is the metrics address a port number rather than a socket path? */
+static int is_port(const char *addr)
+{
+    return *addr && strspn(addr, "0123456789") == strlen(addr);
+}
+
+/* Metrics listener: a TCP port on the loopback interface, or a socket path */
+static int open_metrics(const char *addr)
+{
+    struct sockaddr_in in;
+    long port = strtol(addr, NULL, 10);
+    int fd, one = 1;
+
+    if (!is_port(addr))
+        return open_socket(addr);
+    if (port < 1 || port > 65535) {
+        fprintf(stderr, "Invalid metrics port: %s\n", addr);
+        return -1;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_port = htons((unsigned short)port);
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&in, sizeof(in)) != 0 ||
+        listen(fd, 16) != 0 || set_nonblocking(fd) != 0) {
+        perror(addr);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int service_run(const char *socket_path, const char *metrics_addr)
+{
+    static struct pollfd fds[MAX_CLIENTS + 3];
+    static int fd_slot[MAX_CLIENTS + 3];
+    pthread_t workers[MAX_WORKERS];
+    int num_workers, started = 0, listen_fd, metrics_fd = -1, i;
+    struct sigaction sa;
+    Job *job;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+
+    if (pipe(wake_pipe) != 0 || set_nonblocking(wake_pipe[0]) != 0 ||
+        set_nonblocking(wake_pipe[1]) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    listen_fd = open_socket(socket_path);
+    if (listen_fd < 0)
+        return 1;
+    if (metrics_addr) {
+        metrics_fd = open_metrics(metrics_addr);
+        if (metrics_fd < 0) {
+            close(listen_fd);
+            unlink(socket_path);
+            return 1;
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < MAX_WORKERS; i++)
+        pthread_mutex_init(&worker_counters[i].lock, NULL);
+    num_workers = parallel_num_threads();
+    if (num_workers > MAX_WORKERS)
+        num_workers = MAX_WORKERS;
+    for (i = 0; i < num_workers; i++)
+        if (pthread_create(&workers[started], NULL, worker_main, &worker_counters[started]) == 0)
+            started++;
+    if (started == 0) {
+        fprintf(stderr, "Cannot start worker threads\n");
+        close(listen_fd);
+        unlink(socket_path);
+        if (metrics_fd >= 0) {
+            close(metrics_fd);
+            if (!is_port(metrics_addr))
+                unlink(metrics_addr);
+        }
+        return 1;
+    }
+    pool_workers = started;
+    fprintf(stderr, "Serving on %s with %d workers\n", socket_path, started);
+    if (metrics_fd >= 0)
+        fprintf(stderr, "Metrics on %s\n", metrics_addr);
+
+    while (!stop_requested) {
+        int nfds = 3;
+
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_pipe[0];
+        fds[1].events = POLLIN;
+        fds[2].fd = metrics_fd;   /* ignored by poll() when -1 */
+        fds[2].events = POLLIN;
+        for (i = 0; i < MAX_CLIENTS; i++) {
+            Client *c = &clients[i];
+            /* A closed peer keeps reporting POLLHUP: leave it out until a reply is queued */
+            if (c->fd < 0 || (c->eof && c->out.len == c->out_off))
+                continue;
+            fds[nfds].fd = c->fd;
+            fds[nfds].events = (c->eof ? 0 : POLLIN) | (c->out.len > c->out_off ? POLLOUT : 0);
+            fd_slot[nfds++] = i;
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[256];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+            deliver_replies();
+        }
+        for (i = 3; i < nfds; i++) {
+            Client *c = &clients[fd_slot[i]];
+            if (c->fd < 0)
+                continue;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                client_read(fd_slot[i]);
+            if (c->out.len > c->out_off)
+                client_write(c);
+            if (c->eof && c->pending == 0 && c->out.len == c->out_off)
+                client_close(c);
+        }
+        if (fds[0].revents & POLLIN)
+            accept_clients(listen_fd, 0);
+        if (fds[2].revents & POLLIN)
+            accept_clients(metrics_fd, 1);
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_stopping = 1;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_lock);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    while ((job = queue_pop(&pending_jobs)))
+        job_free(job);
+    while ((job = queue_pop(&finished_jobs)))
+        job_free(job);
+    cache_free_all();
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd >= 0)
+            client_close(&clients[i]);
+    inventory_free_all();
+    close(listen_fd);
+    unlink(socket_path);
+    if (metrics_fd >= 0) {
+        close(metrics_fd);
+        if (!is_port(metrics_addr))
+            unlink(metrics_addr);
+    }
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    fprintf(stderr, "Stopped\n");
+    return 0;
+}
+
+#endif /* !_WIN32 */
@@ -0,0 +1,50 @@
+/*
+ * service.h - Local query service
+ *
+ * `resistorcal --serve PATH` runs the engines as a long-lived daemon on
+ * a Unix domain socket, so tools can query them without starting the
+ * app each time. Every line a client sends is one JSON request, and
+ * every reply is one JSON line carrying the request's "id". Replies on
+ * one connection may arrive out of order. Network sets and their sorted
+ * indexes are kept warm per inventory (value list and part tolerance).
+ * Replies are cached by their parameters; an identical query arriving
+ * while one is computed waits for it, and queued network queries of one
+ * inventory are answered together in one pass over its index.
+ *
+ * Requests (fields other than type are optional, defaults shown):
+ *   {"id":1,"type":"network","values":[...],"target":1000,"tol":0.01,
+ *    "part_tol":0.01,"guaranteed":false,"limit":10}
+ *   {"id":2,"type":"divider","values":[...],"ratio":0.5,"tol":0.01,
+ *    "part_tol":0.01,"min_total":0,"max_total":0,"max_zout":0,
+ *    "max_parts":0,"limit":10}
+ *   {"id":3,"type":"r2r","bits":8,"R":10000,"tol":0,"seed":1}
+ *   {"id":4,"type":"stats"}
+ * Replies:
+ *   {"id":1,"ok":true,"total":N,"results":[{"expr":..,"R":..,...}]}
+ *     network and divider replies add "truncated":true after "total"
+ *     when the inventory has more networks of some size than the engine
+ *     holds (MAX_NETWORKS); only the first of them were searched
+ *   {"id":1,"ok":false,"error":"..."}
+ *   {"id":4,"ok":true,"requests":N,"cache":{"hits":..,"coalesced":..,
+ *    "misses":..,"hit_rate":..},"latency_us":{"le":[1,2,4,..,null],
+ *    "network":[count per bucket],"divider":[..],"r2r":[..],"other":[..]}}
+ *
+ * With a metrics address (a port number, bound to 127.0.0.1, or a socket
+ * path), any HTTP GET there returns counters, latency histograms and
+ * percentiles, cache, inventory memory and pool gauges in the Prometheus
+ * text format.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RESISTORCAL_SERVICE_H
+#define RESISTORCAL_SERVICE_H
+
+/*
+ * Serve queries on a Unix domain socket at socket_path until SIGINT or
+ * SIGTERM, and metrics on metrics_addr unless it is NULL. Returns the
+ * process exit status.
+ */
+int service_run(const char *socket_path, const char *metrics_addr);
+
+#endif /* RESISTORCAL_SERVICE_H */
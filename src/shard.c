@@ -0,0 +1,1582 @@
+/*
+ * shard.c - Sharded deep network search (see shard.h for the protocol)
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L   /* fork, sockets, getaddrinfo under -std=c99 */
+#endif
+
+#include "shard.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+int shard_search(const ShardSpec *spec, ShardResult *results, int max_results, ShardStats *stats)
+{
+    (void)spec;
+    (void)results;
+    (void)max_results;
+    (void)stats;
+    fprintf(stderr, "Sharded search needs fork() and sockets, which this build does not support\n");
+    return -1;
+}
+
+int shard_worker_listen(const char *addr)
+{
+    (void)addr;
+    fprintf(stderr, "Sharded search needs fork() and sockets, which this build does not support\n");
+    return 1;
+}
+
+int shard_main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    return shard_worker_listen(NULL);
+}
+
+#else
+
+#include "parallel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UNIT_LOOKUPS (1L << 16)   /* window lookups per work unit, roughly */
+#define SPLIT_UNITS 256           /* at most, per level and split */
+#define UNITS_IN_FLIGHT 2         /* per worker, so none waits between units */
+
+/* ========================================================================
+ * LINE I/O
+ * ======================================================================== */
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t start, len, cap;       /* unread bytes are buf[start..len) */
+} LineReader;
+
+typedef struct {
+    char *data;
+    size_t off, len, cap;         /* unsent bytes are data[off..len) */
+    int failed;
+} OutBuf;
+
+/* Next complete line (newline stripped), or NULL until more is read */
+static char *reader_line(LineReader *r)
+{
+    char *nl;
+
+    if (r->start == r->len)
+        return NULL;
+    nl = memchr(r->buf + r->start, '\n', r->len - r->start);
+    if (!nl)
+        return NULL;
+    *nl = '\0';
+    {
+        char *line = r->buf + r->start;
+        r->start = (size_t)(nl - r->buf) + 1;
+        return line;
+    }
+}
+
+/* One read(): > 0 bytes read, 0 at end of stream, -1 on error or EAGAIN */
+static int reader_fill(LineReader *r)
+{
+    ssize_t n;
+
+    if (r->start > 0) {
+        memmove(r->buf, r->buf + r->start, r->len - r->start);
+        r->len -= r->start;
+        r->start = 0;
+    }
+    if (r->cap - r->len < 4096) {
+        size_t cap = r->cap ? r->cap * 2 : 65536;
+        char *buf = realloc(r->buf, cap);
+        if (!buf)
+            return -1;
+        r->buf = buf;
+        r->cap = cap;
+    }
+    do
+        n = read(r->fd, r->buf + r->len, r->cap - r->len - 1);
+    while (n < 0 && errno == EINTR);
+    if (n > 0)
+        r->len += (size_t)n;
+    return n > 0 ? 1 : (int)n;
+}
+
+/* Blocking: the next line, or NULL at end of stream */
+static char *reader_wait_line(LineReader *r)
+{
+    char *line;
+
+    while (!(line = reader_line(r)))
+        if (reader_fill(r) <= 0)
+            return NULL;
+    return line;
+}
+
+static void out_printf(OutBuf *b, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (b->failed)
+        return;
+    va_start(ap, fmt);
+    n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if (b->len + (size_t)n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        char *data;
+        while (cap < b->len + (size_t)n + 1)
+            cap *= 2;
+        data = realloc(b->data, cap);
+        if (!data) {
+            b->failed = 1;
+            return;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    b->len += (size_t)n;
+}
+
+/*
+ * Write what the fd takes (all of it when blocking). Returns 0, or -1
+ * once the peer is gone.
+ */
+static int out_flush(OutBuf *b, int fd)
+{
+    while (b->off < b->len) {
+        ssize_t n = write(fd, b->data + b->off, b->len - b->off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        b->off += (size_t)n;
+    }
+    b->off = b->len = 0;
+    return b->failed ? -1 : 0;
+}
+
+/* ========================================================================
+ * CANDIDATES
+ * ======================================================================== */
+
+/* One combination on the way down: op with materialized network (n, i) on the left */
+typedef struct {
+    int op, n, i;
+} Step;
+
+/*
+ * A network by identity: depth steps, outermost first, around the
+ * materialized network (term_n, term_i). Depth 0 is that network alone.
+ */
+typedef struct {
+    double R, R_lo, R_hi, error;
+    int n;                        /* parts */
+    int depth;
+    Step step[MAX_DEEP_PARTS];
+    int term_n, term_i;
+} Candidate;
+
+/* Identity order: depth, then steps outermost first, then the innermost network */
+static int compare_identity(const Candidate *a, const Candidate *b)
+{
+    int k;
+
+    if (a->depth != b->depth) return a->depth - b->depth;
+    for (k = 0; k < a->depth; k++) {
+        if (a->step[k].n != b->step[k].n) return a->step[k].n - b->step[k].n;
+        if (a->step[k].i != b->step[k].i) return a->step[k].i - b->step[k].i;
+        if (a->step[k].op != b->step[k].op) return a->step[k].op - b->step[k].op;
+    }
+    if (a->term_n != b->term_n) return a->term_n - b->term_n;
+    return a->term_i - b->term_i;
+}
+
+/* Error, then part count, then identity: a total order */
+static int compare_candidates(const Candidate *a, const Candidate *b)
+{
+    if (a->error != b->error) return a->error < b->error ? -1 : 1;
+    if (a->n != b->n) return a->n - b->n;
+    return compare_identity(a, b);
+}
+
+static int compare_candidates_qsort(const void *a, const void *b)
+{
+    return compare_candidates((const Candidate *)a, (const Candidate *)b);
+}
+
+/* The k best candidates seen, as a max-heap (worst at the root) */
+typedef struct {
+    Candidate c[MAX_TOP_K];
+    int size, k;
+} TopK;
+
+static double topk_bound(const TopK *top)
+{
+    return top->size == top->k ? top->c[0].error : HUGE_VAL;
+}
+
+static void topk_sift_down(TopK *top, int i)
+{
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, worst = i;
+        Candidate t;
+        if (l < top->size && compare_candidates(&top->c[l], &top->c[worst]) > 0)
+            worst = l;
+        if (r < top->size && compare_candidates(&top->c[r], &top->c[worst]) > 0)
+            worst = r;
+        if (worst == i)
+            return;
+        t = top->c[i];
+        top->c[i] = top->c[worst];
+        top->c[worst] = t;
+        i = worst;
+    }
+}
+
+/* Keep c if it ranks among the k best. Returns 1 if kept. */
+static int topk_offer(TopK *top, const Candidate *c)
+{
+    int i;
+
+    if (top->size == top->k) {
+        if (compare_candidates(c, &top->c[0]) >= 0)
+            return 0;
+        top->c[0] = *c;
+        topk_sift_down(top, 0);
+        return 1;
+    }
+    i = top->size++;
+    top->c[i] = *c;
+    while (i > 0 && compare_candidates(&top->c[(i - 1) / 2], &top->c[i]) < 0) {
+        Candidate t = top->c[i];
+        top->c[i] = top->c[(i - 1) / 2];
+        top->c[(i - 1) / 2] = t;
+        i = (i - 1) / 2;
+    }
+    return 1;
+}
+
+/* Is the same network already kept? A unit re-run after a disconnect repeats some. */
+static int topk_contains(const TopK *top, const Candidate *c)
+{
+    int i;
+    for (i = 0; i < top->size; i++)
+        if (top->c[i].n == c->n && compare_identity(&top->c[i], c) == 0)
+            return 1;
+    return 0;
+}
+
+/* ========================================================================
+ * ENUMERATION
+ * ======================================================================== */
+
+/*
+ * A network of more than `levels` parts is never stored. It splits like
+ * network_set_build_level() pairs: a materialized network of i parts on
+ * the left and one of size - i on the right, which is materialized or
+ * split again. Given the window its R must fall in, the right side's
+ * window follows from the left network and the op, so each split is a
+ * binary search over a level sorted by R rather than a scan of all
+ * pairs. Windows only prune: every network found is tested exactly.
+ */
+
+#define WINDOW_SLACK 1e-9         /* relative; covers rounding in the derived windows */
+
+typedef struct {
+    int levels;                   /* materialized levels */
+    double target, tol;
+    int guaranteed;
+    double lo, hi;                /* window of the worst-case test */
+} Query;
+
+/* A materialized network: its R, worst-case bounds and operands */
+typedef struct {
+    double R, R_lo, R_hi;
+    int left_i, right_i;          /* in levels left_n and right_n */
+    unsigned char op, left_n, right_n;
+} DeepNet;
+
+/*
+ * Every network of up to `levels` parts, nothing cut off: each level is
+ * sorted by ascending R (ties in build order), and R[n] repeats the R of
+ * level n packed for the binary searches.
+ */
+typedef struct {
+    int levels;
+    DeepNet *net[MAX_N + 1];
+    double *R[MAX_N + 1];
+    int count[MAX_N + 1];
+    double min_R[MAX_DEEP_PARTS + 1];   /* R range of any network of n parts */
+    double max_R[MAX_DEEP_PARTS + 1];
+} Levels;
+
+/*
+ * Deepest level count positive values can be materialized to, up to
+ * max_levels, within MAX_DEEP_NETWORKS. Level n pairs i parts with n - i
+ * like network_set_build_level(), in series and in parallel.
+ */
+static int levels_for(int count, int max_levels)
+{
+    double size[MAX_N + 1], total = count;
+    int n, i;
+
+    size[1] = count;
+    for (n = 2; n <= max_levels; n++) {
+        size[n] = 0;
+        for (i = 1; i < n; i++)
+            size[n] += 2.0 * (i == n - i ? size[i] * (size[i] + 1) / 2 : size[i] * size[n - i]);
+        total += size[n];
+        if (total > MAX_DEEP_NETWORKS)
+            return n - 1;
+    }
+    return max_levels;
+}
+
+typedef struct {
+    double R;
+    int i;
+} SortEntry;
+
+static int compare_sort_entries(const void *a, const void *b)
+{
+    const SortEntry *ea = (const SortEntry *)a, *eb = (const SortEntry *)b;
+    if (ea->R != eb->R) return ea->R < eb->R ? -1 : 1;
+    return ea->i - eb->i;
+}
+
+static void levels_free(Levels *lv)
+{
+    int n;
+
+    for (n = 1; n <= MAX_N; n++) {
+        free(lv->net[n]);
+        free(lv->R[n]);
+    }
+}
+
+/* Put level n, built in pairing order, in R order */
+static int sort_level(Levels *lv, int n)
+{
+    int num = lv->count[n], i;
+    SortEntry *sorted = malloc((num > 0 ? num : 1) * sizeof(SortEntry));
+    DeepNet *net = malloc((num > 0 ? num : 1) * sizeof(DeepNet));
+
+    lv->R[n] = malloc((num > 0 ? num : 1) * sizeof(double));
+    if (!sorted || !net || !lv->R[n]) {
+        free(sorted);
+        free(net);
+        return -1;
+    }
+    for (i = 0; i < num; i++) {
+        sorted[i].R = lv->net[n][i].R;
+        sorted[i].i = i;
+    }
+    qsort(sorted, num, sizeof(SortEntry), compare_sort_entries);
+    for (i = 0; i < num; i++) {
+        net[i] = lv->net[n][sorted[i].i];
+        lv->R[n][i] = sorted[i].R;
+    }
+    free(lv->net[n]);
+    lv->net[n] = net;
+    free(sorted);
+    return 0;
+}
+
+/* Level 1 from values, then every combination of levels 2..levels */
+static int build_levels(Levels *lv, const double *values, int count, double part_tol, int levels)
+{
+    int n, i, a, b, k;
+
+    memset(lv, 0, sizeof(*lv));
+    lv->levels = levels;
+    lv->min_R[1] = lv->max_R[1] = values[0];
+    for (k = 1; k < count; k++) {
+        if (values[k] < lv->min_R[1]) lv->min_R[1] = values[k];
+        if (values[k] > lv->max_R[1]) lv->max_R[1] = values[k];
+    }
+    for (n = 2; n <= MAX_DEEP_PARTS; n++) {
+        lv->min_R[n] = lv->min_R[1] / n;      /* all in parallel */
+        lv->max_R[n] = lv->max_R[1] * n;      /* all in series */
+    }
+    for (n = 1; n <= levels; n++) {
+        long size = 0;
+
+        if (n == 1)
+            size = count;
+        for (i = 1; i < n; i++)
+            size += 2L * (i == n - i ? (long)lv->count[i] * (lv->count[i] + 1) / 2
+                                     : (long)lv->count[i] * lv->count[n - i]);
+        lv->net[n] = malloc((size > 0 ? size : 1) * sizeof(DeepNet));
+        if (!lv->net[n])
+            goto fail;
+        lv->count[n] = (int)size;
+
+        if (n == 1)
+            for (k = 0; k < count; k++) {
+                DeepNet *d = &lv->net[1][k];
+                d->R = values[k];
+                d->R_lo = values[k] * (1.0 - part_tol);
+                d->R_hi = values[k] * (1.0 + part_tol);
+                d->op = NET_LEAF;
+                d->left_n = d->right_n = 0;
+                d->left_i = d->right_i = -1;
+            }
+        k = 0;
+        for (i = 1; i < n; i++)
+            for (a = 0; a < lv->count[i]; a++)
+                for (b = i == n - i ? a : 0; b < lv->count[n - i]; b++) {
+                    const DeepNet *A = &lv->net[i][a], *B = &lv->net[n - i][b];
+                    DeepNet *ser = &lv->net[n][k++], *par = &lv->net[n][k++];
+
+                    ser->R = A->R + B->R;
+                    ser->R_lo = A->R_lo + B->R_lo;
+                    ser->R_hi = A->R_hi + B->R_hi;
+                    ser->op = NET_SERIES;
+                    par->R = 1.0 / ((1.0 / A->R) + (1.0 / B->R));
+                    par->R_lo = 1.0 / ((1.0 / A->R_lo) + (1.0 / B->R_lo));
+                    par->R_hi = 1.0 / ((1.0 / A->R_hi) + (1.0 / B->R_hi));
+                    par->op = NET_PARALLEL;
+                    ser->left_n = par->left_n = (unsigned char)i;
+                    ser->left_i = par->left_i = a;
+                    ser->right_n = par->right_n = (unsigned char)(n - i);
+                    ser->right_i = par->right_i = b;
+                }
+        if (sort_level(lv, n) != 0)
+            goto fail;
+    }
+    return 0;
+
+fail:
+    levels_free(lv);
+    return -1;
+}
+
+/* Same test as network_matches() without an operating point */
+static int in_spec(const Query *q, double R, double R_lo, double R_hi, double *error)
+{
+    *error = fabs(R - q->target) / q->target;
+    if (*error > q->tol)
+        return 0;
+    return !q->guaranteed || (R_lo >= q->lo && R_hi <= q->hi);
+}
+
+/* Lookups per right-hand side of size, for sizing work units */
+static double search_cost(const Levels *lv, int size)
+{
+    double cost = 0;
+    int i;
+
+    if (size <= lv->levels)
+        return 1;
+    for (i = 1; 2 * i <= size && i <= lv->levels; i++)
+        cost += 2.0 * lv->count[i] * search_cost(lv, size - i);
+    return cost;
+}
+
+/* One worker's search state */
+typedef struct {
+    const Levels *lv;
+    const Query *q;
+    const double *bound;          /* coordinator's K-th best error */
+    TopK *local;                  /* this worker's best; only those are sent */
+    OutBuf *out;
+    int fd;
+    Step chain[MAX_DEEP_PARTS];   /* steps around the subnetwork searched */
+    int depth;
+    double b;                     /* error bound the top window was made for */
+    double top_lo, top_hi;        /* window of the whole network */
+    unsigned version;             /* bumped whenever the top window narrows */
+    long tested;
+    long work, budget;            /* lookups and tests in this unit; 0 = no budget */
+    int cut;                      /* the unit ran out of budget */
+} Search;
+
+/* First index of the ascending R[0..count) with R >= x, or with R > x if above */
+static int bound_index(const double *R, int count, double x, int above)
+{
+    int first = 0, last = count;
+
+    while (first < last) {
+        int mid = first + (last - first) / 2;
+        if (R[mid] < x || (above && R[mid] == x))
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    return first;
+}
+
+/*
+ * Window of B in A op B from the window of the result. Returns 0, or
+ * -1 if no positive B fits.
+ */
+static int child_window(int op, double A, double *lo, double *hi)
+{
+    if (op == NET_SERIES) {
+        if (*hi <= A)
+            return -1;
+        *lo = *lo > A ? *lo - A : 0;
+        *hi -= A;
+    } else {
+        if (*lo >= A)
+            return -1;
+        *lo = *lo > 0 ? 1.0 / (1.0 / *lo - 1.0 / A) : 0;
+        *hi = *hi < A ? 1.0 / (1.0 / *hi - 1.0 / A) : HUGE_VAL;
+    }
+    return 0;
+}
+
+/*
+ * Networks [*first, *last) of level n that can land A op B in [lo, hi]
+ * with some B of size parts, from the R range of those B.
+ */
+static void left_range(const Levels *lv, int op, int n, int size, double lo, double hi,
+                       int *first, int *last)
+{
+    double ymin = lv->min_R[size], ymax = lv->max_R[size], a_lo, a_hi;
+
+    if (op == NET_SERIES) {
+        a_lo = lo - ymax;
+        a_hi = hi - ymin;
+    } else {
+        /* 1/A = 1/R - 1/B */
+        if (ymax <= lo) {
+            *first = *last = 0;
+            return;
+        }
+        a_lo = lo > 0 ? 1.0 / (1.0 / lo - 1.0 / ymax) : 0;
+        a_hi = hi < ymin ? 1.0 / (1.0 / hi - 1.0 / ymin) : HUGE_VAL;
+    }
+    *first = bound_index(lv->R[n], lv->count[n], a_lo * (1.0 - WINDOW_SLACK), 0);
+    *last = bound_index(lv->R[n], lv->count[n], a_hi * (1.0 + WINDOW_SLACK), 1);
+}
+
+/* Narrow the top window once the K-th best error improved. Returns 1 if it did. */
+static int search_tighten(Search *s)
+{
+    double b = s->q->tol, local = topk_bound(s->local);
+
+    if (*s->bound < b) b = *s->bound;
+    if (local < b) b = local;
+    if (b >= s->b)
+        return 0;
+    s->b = b;
+    s->top_lo = s->q->target * (1.0 - b) * (1.0 - WINDOW_SLACK);
+    s->top_hi = s->q->target * (1.0 + b) * (1.0 + WINDOW_SLACK);
+    s->version++;
+    return 1;
+}
+
+/* Current window of the subnetwork inside the chain. Returns 0, or -1 if empty. */
+static int search_window(const Search *s, double *lo, double *hi)
+{
+    int k;
+
+    *lo = s->top_lo;
+    *hi = s->top_hi;
+    for (k = 0; k < s->depth; k++)
+        if (child_window(s->chain[k].op, s->lv->R[s->chain[k].n][s->chain[k].i], lo, hi) != 0)
+            return -1;
+    return 0;
+}
+
+/* Count one lookup or test against the unit's budget. Returns 1 once it is spent. */
+static int search_spend(Search *s)
+{
+    if (++s->work > s->budget && s->budget > 0)
+        s->cut = 1;
+    return s->cut;
+}
+
+/* The chain around materialized network (n, i): test it, send it if it ranks */
+static void search_emit(Search *s, int n, int i)
+{
+    const DeepNet *T = &s->lv->net[n][i];
+    double R = T->R, R_lo = T->R_lo, R_hi = T->R_hi;
+    Candidate c;
+    int k;
+
+    c.n = n;
+    for (k = s->depth - 1; k >= 0; k--) {
+        const Step *st = &s->chain[k];
+        const DeepNet *A = &s->lv->net[st->n][st->i];
+        if (st->op == NET_SERIES) {
+            R = A->R + R;
+            R_lo = A->R_lo + R_lo;
+            R_hi = A->R_hi + R_hi;
+        } else {
+            R = 1.0 / ((1.0 / A->R) + (1.0 / R));
+            R_lo = 1.0 / ((1.0 / A->R_lo) + (1.0 / R_lo));
+            R_hi = 1.0 / ((1.0 / A->R_hi) + (1.0 / R_hi));
+        }
+        c.n += st->n;
+    }
+    s->tested++;
+    if (!in_spec(s->q, R, R_lo, R_hi, &c.error) || c.error > *s->bound)
+        return;
+
+    c.R = R;
+    c.R_lo = R_lo;
+    c.R_hi = R_hi;
+    c.depth = s->depth;
+    memcpy(c.step, s->chain, s->depth * sizeof(Step));
+    c.term_n = n;
+    c.term_i = i;
+    if (!topk_offer(s->local, &c))
+        return;
+
+    out_printf(s->out, "C %.17g %.17g %.17g %d", R, R_lo, R_hi, c.depth);
+    for (k = 0; k < c.depth; k++)
+        out_printf(s->out, " %d %d %d", c.step[k].op, c.step[k].n, c.step[k].i);
+    out_printf(s->out, " %d %d\n", n, i);
+    if (s->out->len > 65536)
+        out_flush(s->out, s->fd);
+}
+
+static int search_split(Search *s, int size, int n, double lo, double hi, int first, int last);
+
+/* Every network of size parts with R in [lo, hi], right of the current chain */
+static void search_size(Search *s, int size, double lo, double hi, int min_index)
+{
+    const Levels *lv = s->lv;
+    int i;
+
+    if (search_spend(s))
+        return;
+    if (size <= lv->levels) {
+        const double *R = lv->R[size];
+        int count = lv->count[size], k = bound_index(R, count, lo, 0);
+
+        if (k < min_index)
+            k = min_index;
+        for (; k < count && R[k] <= hi && !search_spend(s); k++)
+            search_emit(s, size, k);
+        return;
+    }
+    /* The left side is materialized; splits with both sides deeper are not reached */
+    for (i = 1; 2 * i <= size && i <= lv->levels; i++)
+        if (search_split(s, size, i, lo, hi, 0, lv->count[i]) != 0)
+            return;
+}
+
+/*
+ * Networks of size parts with R in [lo, hi] whose left side is network
+ * first..last-1 of level n, in series and in parallel. Returns 0, or -1
+ * once the window is empty or the budget spent.
+ */
+static int search_split(Search *s, int size, int n, double lo, double hi, int first, int last)
+{
+    const Levels *lv = s->lv;
+    unsigned version = s->version;
+    int op, a, end, rest = size - n;
+
+    for (op = NET_SERIES; op <= NET_PARALLEL; op++) {
+        left_range(lv, op, n, rest, lo, hi, &a, &end);
+        for (a = a > first ? a : first; a < end && a < last; a++) {
+            double A = lv->R[n][a], child_lo = lo, child_hi = hi;
+            Step *st;
+
+            /* Nothing worse than the K-th best so far can rank: the window narrows with it */
+            search_tighten(s);
+            if (version != s->version) {
+                int from;
+                version = s->version;
+                if (search_window(s, &lo, &hi) != 0)
+                    return -1;
+                left_range(lv, op, n, rest, lo, hi, &from, &end);
+                if (a < from) {
+                    a = from - 1;
+                    continue;
+                }
+                child_lo = lo;
+                child_hi = hi;
+            }
+            if (child_window(op, A, &child_lo, &child_hi) != 0)
+                continue;
+            st = &s->chain[s->depth++];
+            st->op = op;
+            st->n = n;
+            st->i = a;
+            /* equal halves pair once, as the engine does */
+            search_size(s, rest, child_lo, child_hi, n == rest ? a : 0);
+            s->depth--;
+            if (s->cut)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Networks of level parts split first..last-1 of level split on the
+ * left, within budget lookups and tests (0 = no limit). Sets s->cut if
+ * the budget ran out first.
+ */
+static void run_unit(Search *s, int level, int split, int first, int last, long budget)
+{
+    double lo, hi;
+
+    s->work = 0;
+    s->budget = budget;
+    s->cut = 0;
+    s->depth = 0;
+    search_tighten(s);
+    if (search_window(s, &lo, &hi) == 0)
+        search_split(s, level, split, lo, hi, first, last);
+}
+
+/* ========================================================================
+ * WORKER
+ * ======================================================================== */
+
+/*
+ * Serve one coordinator: a Q line, then units until E. prebuilt, when
+ * given, already holds the levels (a forked worker shares the parent's).
+ * Returns 0 when the coordinator ended the search, -1 otherwise.
+ */
+static int worker_session(int in_fd, int out_fd, const Levels *prebuilt)
+{
+    LineReader in = { in_fd, NULL, 0, 0, 0 };
+    OutBuf out = { NULL, 0, 0, 0, 0 };
+    Levels own;
+    Search search;
+    TopK *local = malloc(sizeof(TopK));
+    Query q;
+    double bound = HUGE_VAL, part_tol, *values = NULL;
+    int k, count, i, ret = -1;
+    char *line, *p;
+
+    memset(&own, 0, sizeof(own));
+    memset(&search, 0, sizeof(search));
+    line = reader_wait_line(&in);
+    if (!local || !line ||
+        sscanf(line, "Q %d %lf %lf %d %d %lf %d", &q.levels, &q.target, &q.tol,
+               &q.guaranteed, &k, &part_tol, &count) != 7 ||
+        k < 1 || k > MAX_TOP_K || count < 1 || count > MAX_NETWORKS || q.target <= 0 ||
+        q.levels < 1 || q.levels > levels_for(count, MAX_N))
+        goto out;
+    q.lo = q.target * (1.0 - q.tol);
+    q.hi = q.target * (1.0 + q.tol);
+    local->size = 0;              /* kept across units: its K-th best stays a valid bound */
+    local->k = k;
+
+    search.lv = prebuilt;
+    if (!prebuilt) {
+        values = malloc(count * sizeof(double));
+        if (!values)
+            goto out;
+        p = line;
+        for (i = 0; i < 8; i++)         /* skip "Q" and the seven fields */
+            p = strchr(p, ' ') ? strchr(p, ' ') + 1 : p + strlen(p);
+        for (i = 0; i < count; i++) {
+            values[i] = strtod(p, &p);
+            if (!(values[i] > 0))
+                goto out;
+        }
+        if (build_levels(&own, values, count, part_tol, q.levels) != 0)
+            goto out;
+        search.lv = &own;
+    }
+    search.q = &q;
+    search.bound = &bound;
+    search.b = HUGE_VAL;
+    search.local = local;
+    search.out = &out;
+    search.fd = out_fd;
+
+    while ((line = reader_wait_line(&in))) {
+        int id, level, split, first, last;
+        long budget;
+
+        if (line[0] == 'E') {
+            ret = 0;
+            break;
+        }
+        if (line[0] == 'B') {
+            bound = strtod(line + 1, NULL);
+            continue;
+        }
+        if (sscanf(line, "U %d %d %d %d %d %ld", &id, &level, &split, &first, &last,
+                   &budget) != 6 || level <= q.levels || level > MAX_DEEP_PARTS ||
+            split < 1 || split > q.levels || 2 * split > level || first < 0)
+            break;
+        search.tested = 0;
+        run_unit(&search, level, split, first, last, budget);
+        out_printf(&out, "D %d %ld %ld %d\n", id, search.tested, search.work, search.cut);
+        if (out_flush(&out, out_fd) != 0)
+            break;
+    }
+
+out:
+    if (search.lv == &own)
+        levels_free(&own);
+    free(values);
+    free(local);
+    free(in.buf);
+    free(out.data);
+    return ret;
+}
+
+/* Split [HOST:]PORT; host defaults to def */
+static void split_addr(const char *addr, const char *def, char *host, size_t size, const char **port)
+{
+    const char *colon = strrchr(addr, ':');
+
+    if (colon) {
+        size_t n = (size_t)(colon - addr) < size - 1 ? (size_t)(colon - addr) : size - 1;
+        memcpy(host, addr, n);
+        host[n] = '\0';
+        *port = colon + 1;
+    } else {
+        snprintf(host, size, "%s", def);
+        *port = addr;
+    }
+}
+
+int shard_worker_listen(const char *addr)
+{
+    struct addrinfo hints, *res;
+    char host[256];
+    const char *port;
+    int fd, one = 1;
+
+    split_addr(addr, "127.0.0.1", host, sizeof(host), &port);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        fprintf(stderr, "Cannot resolve %s\n", addr);
+        return 1;
+    }
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, res->ai_addr, res->ai_addrlen) != 0 || listen(fd, 4) != 0) {
+        perror(addr);
+        freeaddrinfo(res);
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    freeaddrinfo(res);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Shard worker on %s:%s\n", host, port);
+
+    for (;;) {
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            close(fd);
+            return 1;
+        }
+        worker_session(conn, conn, NULL);
+        close(conn);
+    }
+}
+
+/* ========================================================================
+ * COORDINATOR
+ * ======================================================================== */
+
+typedef struct {
+    int level, split, first, last;
+    double cost;                  /* estimated lookups */
+} Unit;
+
+typedef struct {
+    int in_fd, out_fd;            /* the same socket for TCP workers */
+    pid_t pid;                    /* forked workers, else 0 */
+    LineReader in;
+    OutBuf out;
+    int unit[UNITS_IN_FLIGHT];    /* outstanding units, oldest first */
+    int num_units;
+    int alive;
+} Worker;
+
+typedef struct {
+    const Levels *lv;
+    const Query *q;
+    Unit *units;
+    int num_units;
+    int *todo;                    /* stack of units to hand out */
+    int num_todo;
+    int done;
+    Worker *workers;
+    int num_workers;
+    TopK *top;
+    double sent_bound;            /* last bound broadcast */
+    long max_work;                /* lookups and tests over all units, 0 = no limit */
+    long work, tested, streamed;
+    int cut;                      /* units that ran out of budget */
+} Coordinator;
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/* Costliest first, so the long units do not all start last */
+static int compare_units(const void *a, const void *b)
+{
+    const Unit *ua = (const Unit *)a, *ub = (const Unit *)b;
+    if (ua->cost != ub->cost) return ua->cost > ub->cost ? -1 : 1;
+    if (ua->level != ub->level) return ua->level - ub->level;
+    if (ua->split != ub->split) return ua->split - ub->split;
+    return ua->first - ub->first;
+}
+
+/*
+ * Work units of the unmaterialized levels: every split of each level,
+ * in runs of left networks of about UNIT_LOOKUPS lookups each.
+ */
+static int make_units(const Levels *lv, int parts, Unit **units)
+{
+    int level, split, count = 0, cap = 256;
+
+    *units = malloc(cap * sizeof(Unit));
+    if (!*units)
+        return -1;
+    for (level = lv->levels + 1; level <= parts; level++)
+        for (split = 1; 2 * split <= level && split <= lv->levels; split++) {
+            double row = 2.0 * search_cost(lv, level - split);
+            int first, rows = row < UNIT_LOOKUPS ? (int)(UNIT_LOOKUPS / row) : 1;
+
+            if (rows < (lv->count[split] + SPLIT_UNITS - 1) / SPLIT_UNITS)
+                rows = (lv->count[split] + SPLIT_UNITS - 1) / SPLIT_UNITS;
+
+            for (first = 0; first < lv->count[split]; first += rows) {
+                Unit *u;
+                if (count == cap) {
+                    Unit *grown = realloc(*units, (cap *= 2) * sizeof(Unit));
+                    if (!grown)
+                        return -1;
+                    *units = grown;
+                }
+                u = &(*units)[count++];
+                u->level = level;
+                u->split = split;
+                u->first = first;
+                u->last = first + rows < lv->count[split] ? first + rows : lv->count[split];
+                u->cost = row * (u->last - u->first);
+            }
+        }
+    if (count > 1)
+        qsort(*units, count, sizeof(Unit), compare_units);
+    return count;
+}
+
+static void send_units(Coordinator *co, Worker *w)
+{
+    while (w->alive && w->num_units < UNITS_IN_FLIGHT && co->num_todo > 0) {
+        int id = co->todo[--co->num_todo];
+        const Unit *u = &co->units[id];
+        long budget = 0;
+
+        /* An even share of what is left; units that finish early leave more */
+        if (co->max_work > 0) {
+            budget = (co->max_work - co->work) / (co->num_units - co->done);
+            if (budget < 1)
+                budget = 1;
+        }
+        w->unit[w->num_units++] = id;
+        out_printf(&w->out, "U %d %d %d %d %d %ld\n", id, u->level, u->split, u->first, u->last,
+                   budget);
+    }
+}
+
+/* Tell every worker the new K-th best error once it has improved */
+static void broadcast_bound(Coordinator *co)
+{
+    double bound = topk_bound(co->top);
+    int i;
+
+    if (bound >= co->sent_bound)
+        return;
+    co->sent_bound = bound;
+    for (i = 0; i < co->num_workers; i++)
+        if (co->workers[i].alive)
+            out_printf(&co->workers[i].out, "B %.17g\n", bound);
+}
+
+/* A worker is gone: its outstanding units go back on the stack */
+static void worker_lost(Coordinator *co, Worker *w)
+{
+    int i;
+
+    if (!w->alive)
+        return;
+    w->alive = 0;
+    for (i = 0; i < w->num_units; i++)
+        co->todo[co->num_todo++] = w->unit[i];
+    w->num_units = 0;
+    fprintf(stderr, "Shard worker lost; %d units left\n", co->num_units - co->done);
+}
+
+static int parse_int(const char **p, int lo, int hi, int *out)
+{
+    char *end;
+    long v = strtol(*p, &end, 10);
+    if (end == *p || v < lo || v > hi)
+        return -1;
+    *p = end;
+    *out = (int)v;
+    return 0;
+}
+
+/* A materialized network id from a worker (which may be remote) */
+static int parse_network(const Levels *lv, const char **p, int *n, int *i)
+{
+    if (parse_int(p, 1, lv->levels, n) != 0)
+        return -1;
+    return parse_int(p, 0, lv->count[*n] - 1, i);
+}
+
+/* "C R R_lo R_hi depth [op n i]... n i". Returns 0, or -1 if malformed. */
+static int parse_candidate(const Coordinator *co, const char *line, Candidate *c)
+{
+    const char *p = line + 1;
+    char *end;
+    int k;
+
+    c->R = strtod(p, &end);
+    c->R_lo = strtod(end, &end);
+    c->R_hi = strtod(end, &end);
+    p = end;
+    if (!(c->R > 0) || parse_int(&p, 0, MAX_DEEP_PARTS - 1, &c->depth) != 0)
+        return -1;
+    c->n = 0;
+    for (k = 0; k < c->depth; k++) {
+        if (parse_int(&p, NET_SERIES, NET_PARALLEL, &c->step[k].op) != 0 ||
+            parse_network(co->lv, &p, &c->step[k].n, &c->step[k].i) != 0)
+            return -1;
+        c->n += c->step[k].n;
+    }
+    if (parse_network(co->lv, &p, &c->term_n, &c->term_i) != 0)
+        return -1;
+    c->n += c->term_n;
+    c->error = fabs(c->R - co->q->target) / co->q->target;
+    return c->n <= MAX_DEEP_PARTS ? 0 : -1;
+}
+
+static void handle_line(Coordinator *co, Worker *w, const char *line)
+{
+    if (line[0] == 'C' && w->num_units > 0) {
+        Candidate c;
+
+        if (parse_candidate(co, line, &c) != 0)
+            return;
+        co->streamed++;
+        if (!topk_contains(co->top, &c))
+            topk_offer(co->top, &c);
+    } else if (line[0] == 'D' && w->num_units > 0) {
+        long tested = 0, work = 0;
+        int cut = 0;
+        sscanf(line, "D %*d %ld %ld %d", &tested, &work, &cut);
+        co->tested += tested;
+        co->work += work;
+        co->cut += cut != 0;
+        co->done++;
+        memmove(w->unit, w->unit + 1, (--w->num_units) * sizeof(int));
+        send_units(co, w);
+    }
+}
+
+/* Run every unit on the workers. Returns 0, or -1 if all were lost first. */
+static int coordinate(Coordinator *co)
+{
+    struct pollfd fds[2 * MAX_SHARD_WORKERS];
+    int i;
+
+    while (co->done < co->num_units) {
+        int nfds = 0, live = 0;
+
+        for (i = 0; i < co->num_workers; i++) {
+            Worker *w = &co->workers[i];
+            if (!w->alive)
+                continue;
+            live++;
+            send_units(co, w);
+            if (out_flush(&w->out, w->out_fd) != 0) {
+                worker_lost(co, w);
+                continue;
+            }
+            fds[nfds].fd = w->in_fd;
+            fds[nfds].events = POLLIN;
+            if (w->out_fd == w->in_fd && w->out.len > w->out.off)
+                fds[nfds].events |= POLLOUT;
+            nfds++;
+            if (w->out_fd != w->in_fd && w->out.len > w->out.off) {
+                fds[nfds].fd = w->out_fd;
+                fds[nfds].events = POLLOUT;
+                nfds++;
+            }
+        }
+        if (live == 0)
+            return -1;
+        if (nfds == 0)
+            continue;               /* every live worker was just lost */
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return -1;
+        }
+
+        for (i = 0; i < co->num_workers; i++) {
+            Worker *w = &co->workers[i];
+            int r;
+            char *line;
+
+            if (!w->alive)
+                continue;
+            r = reader_fill(&w->in);
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                worker_lost(co, w);
+            while ((line = reader_line(&w->in)))
+                handle_line(co, w, line);
+        }
+        broadcast_bound(co);        /* the others prune with it from their next unit */
+    }
+    return 0;
+}
+
+/* Start a local worker process over a pair of pipes */
+static int fork_worker(Worker *w, const Levels *lv)
+{
+    int to_worker[2], from_worker[2];
+
+    if (pipe(to_worker) != 0)
+        return -1;
+    if (pipe(from_worker) != 0) {
+        close(to_worker[0]);
+        close(to_worker[1]);
+        return -1;
+    }
+    w->pid = fork();
+    if (w->pid < 0) {
+        close(to_worker[0]);
+        close(to_worker[1]);
+        close(from_worker[0]);
+        close(from_worker[1]);
+        return -1;
+    }
+    if (w->pid == 0) {
+        close(to_worker[1]);
+        close(from_worker[0]);
+        _exit(worker_session(to_worker[0], from_worker[1], lv) == 0 ? 0 : 1);
+    }
+    close(to_worker[0]);
+    close(from_worker[1]);
+    w->in_fd = from_worker[0];
+    w->out_fd = to_worker[1];
+    return 0;
+}
+
+static int connect_worker(Worker *w, const char *addr)
+{
+    struct addrinfo hints, *res, *ai;
+    char host[256];
+    const char *port;
+    int fd = -1;
+
+    split_addr(addr, "127.0.0.1", host, sizeof(host), &port);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        fprintf(stderr, "Cannot resolve %s\n", addr);
+        return -1;
+    }
+    for (ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot connect to %s\n", addr);
+        return -1;
+    }
+    w->in_fd = w->out_fd = fd;
+    w->pid = 0;
+    return 0;
+}
+
+/* Start the workers and queue the query on each. Returns how many started. */
+static int start_workers(const ShardSpec *spec, const Query *q, int k,
+                         const Levels *lv, Worker *workers)
+{
+    int count = 0, i;
+
+    if (spec->connect) {
+        char *list = malloc(strlen(spec->connect) + 1), *addr, *save = NULL;
+        if (!list)
+            return 0;
+        strcpy(list, spec->connect);
+        for (addr = strtok_r(list, ",", &save); addr && count < MAX_SHARD_WORKERS;
+             addr = strtok_r(NULL, ",", &save))
+            if (connect_worker(&workers[count], addr) == 0)
+                count++;
+        free(list);
+    } else {
+        int wanted = spec->workers > 0 ? spec->workers : parallel_num_threads();
+        if (wanted > MAX_SHARD_WORKERS)
+            wanted = MAX_SHARD_WORKERS;
+        fflush(NULL);               /* children must not flush the parent's stdio */
+        for (i = 0; i < wanted; i++)
+            if (fork_worker(&workers[count], lv) == 0)
+                count++;
+    }
+
+    for (i = 0; i < count; i++) {
+        Worker *w = &workers[i];
+        int v;
+        memset(&w->in, 0, sizeof(w->in));
+        memset(&w->out, 0, sizeof(w->out));
+        w->in.fd = w->in_fd;
+        w->num_units = 0;
+        w->alive = 1;
+        set_nonblocking(w->in_fd);
+        set_nonblocking(w->out_fd);
+        out_printf(&w->out, "Q %d %.17g %.17g %d %d %.17g %d", q->levels, q->target, q->tol,
+                   q->guaranteed, k, spec->part_tol, spec->count);
+        for (v = 0; v < spec->count; v++)
+            out_printf(&w->out, " %.17g", spec->values[v]);
+        out_printf(&w->out, "\n");
+    }
+    return count;
+}
+
+static void stop_workers(Worker *workers, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        Worker *w = &workers[i];
+        if (w->alive) {
+            int flags = fcntl(w->out_fd, F_GETFL, 0);
+            fcntl(w->out_fd, F_SETFL, flags & ~O_NONBLOCK);
+            out_printf(&w->out, "E\n");
+            out_flush(&w->out, w->out_fd);
+        }
+        close(w->in_fd);
+        if (w->out_fd != w->in_fd)
+            close(w->out_fd);
+        if (w->pid > 0)
+            waitpid(w->pid, NULL, 0);
+        free(w->in.buf);
+        free(w->out.data);
+    }
+}
+
+/* Append str at *pos of buf; *pos counts on past size so truncation shows */
+static void expr_put(char *buf, size_t size, size_t *pos, const char *str)
+{
+    size_t len = strlen(str);
+
+    if (*pos < size)
+        memcpy(buf + *pos, str, *pos + len < size ? len : size - *pos);
+    *pos += len;
+}
+
+/* Expression of materialized network (n, i), as the engine writes it */
+static void net_expr(const Levels *lv, int n, int i, char *buf, size_t size, size_t *pos)
+{
+    const DeepNet *d = &lv->net[n][i];
+
+    if (d->op == NET_LEAF) {
+        char value[32];
+        snprintf(value, sizeof(value), "%.2f", d->R);
+        expr_put(buf, size, pos, value);
+        return;
+    }
+    expr_put(buf, size, pos, "(");
+    net_expr(lv, d->left_n, d->left_i, buf, size, pos);
+    expr_put(buf, size, pos, d->op == NET_SERIES ? " + " : " ∥ ");
+    net_expr(lv, d->right_n, d->right_i, buf, size, pos);
+    expr_put(buf, size, pos, ")");
+}
+
+/* Expression of a candidate. Ends in "..." if it does not fit. */
+static void candidate_expr(const Levels *lv, const Candidate *c, char *expr)
+{
+    size_t pos = 0;
+    int k;
+
+    for (k = 0; k < c->depth; k++) {
+        expr_put(expr, MAX_DEEP_EXPR, &pos, "(");
+        net_expr(lv, c->step[k].n, c->step[k].i, expr, MAX_DEEP_EXPR, &pos);
+        expr_put(expr, MAX_DEEP_EXPR, &pos, c->step[k].op == NET_SERIES ? " + " : " ∥ ");
+    }
+    net_expr(lv, c->term_n, c->term_i, expr, MAX_DEEP_EXPR, &pos);
+    for (k = 0; k < c->depth; k++)
+        expr_put(expr, MAX_DEEP_EXPR, &pos, ")");
+    if (pos < MAX_DEEP_EXPR)
+        expr[pos] = '\0';
+    else
+        memcpy(expr + MAX_DEEP_EXPR - 4, "...", 4);
+}
+
+int shard_search(const ShardSpec *spec, ShardResult *results, int max_results, ShardStats *stats)
+{
+    Levels lv;
+    Query q;
+    Coordinator co;
+    Worker *workers = NULL;
+    int k = max_results < MAX_TOP_K ? max_results : MAX_TOP_K;
+    int n, i, ret = -1;
+    struct timespec t0, t1;
+
+    if (spec->count < 1 || spec->count > MAX_NETWORKS || spec->target <= 0 ||
+        spec->tol < 0 || k < 1 || spec->parts < 1 || spec->parts > MAX_DEEP_PARTS) {
+        fprintf(stderr, "Deep search needs 1-%d values, a positive target and 1-%d parts\n",
+                MAX_NETWORKS, MAX_DEEP_PARTS);
+        return -1;
+    }
+    for (i = 0; i < spec->count; i++)
+        if (!(spec->values[i] > 0)) {
+            fprintf(stderr, "Deep search values must be positive\n");
+            return -1;
+        }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    memset(&co, 0, sizeof(co));
+    q.levels = levels_for(spec->count, spec->parts < MAX_N ? spec->parts : MAX_N);
+    q.target = spec->target;
+    q.tol = spec->tol;
+    q.guaranteed = spec->guaranteed;
+    q.lo = q.target * (1.0 - q.tol);
+    q.hi = q.target * (1.0 + q.tol);
+    if (build_levels(&lv, spec->values, spec->count, spec->part_tol, q.levels) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    co.lv = &lv;
+    co.q = &q;
+    co.top = malloc(sizeof(TopK));
+    co.num_units = make_units(&lv, spec->parts, &co.units);
+    co.todo = co.num_units > 0 ? malloc(co.num_units * sizeof(int)) : NULL;
+    if (!co.top || co.num_units < 0 || (co.num_units > 0 && !co.todo)) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+    co.top->size = 0;
+    co.top->k = k;
+    co.sent_bound = HUGE_VAL;
+    co.max_work = spec->max_work;
+
+    /* Materialized levels are scanned here */
+    for (n = 1; n <= q.levels; n++)
+        for (i = 0; i < lv.count[n]; i++) {
+            const DeepNet *net = &lv.net[n][i];
+            Candidate c;
+            if (in_spec(&q, net->R, net->R_lo, net->R_hi, &c.error)) {
+                c.R = net->R;
+                c.R_lo = net->R_lo;
+                c.R_hi = net->R_hi;
+                c.n = n;
+                c.depth = 0;
+                c.term_n = n;
+                c.term_i = i;
+                topk_offer(co.top, &c);
+            }
+        }
+
+    if (co.num_units > 0) {
+        /* Costliest first; cheapest first under a budget, so the costly units get what is left */
+        for (i = 0; i < co.num_units; i++)
+            co.todo[i] = co.max_work > 0 ? i : co.num_units - 1 - i;
+        co.num_todo = co.num_units;
+        workers = calloc(MAX_SHARD_WORKERS, sizeof(Worker));
+        if (!workers) {
+            fprintf(stderr, "Out of memory\n");
+            goto out;
+        }
+        signal(SIGPIPE, SIG_IGN);
+        co.workers = workers;
+        co.num_workers = start_workers(spec, &q, k, &lv, workers);
+        if (co.num_workers == 0) {
+            fprintf(stderr, "No shard workers could be started\n");
+            goto out;
+        }
+        broadcast_bound(&co);
+        i = coordinate(&co);
+        stop_workers(workers, co.num_workers);
+        if (i != 0) {
+            fprintf(stderr, "Every shard worker was lost; %d of %d units done\n",
+                    co.done, co.num_units);
+            goto out;
+        }
+    }
+
+    if (co.top->size > 1)
+        qsort(co.top->c, co.top->size, sizeof(Candidate), compare_candidates_qsort);
+    for (i = 0; i < co.top->size; i++) {
+        const Candidate *c = &co.top->c[i];
+        results[i].R = c->R;
+        results[i].R_lo = c->R_lo;
+        results[i].R_hi = c->R_hi;
+        results[i].error = c->error;
+        results[i].n = c->n;
+        candidate_expr(&lv, c, results[i].expr);
+    }
+    ret = co.top->size;
+
+    if (stats) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        stats->levels = q.levels;
+        stats->complete = spec->parts <= 2 * q.levels;
+        stats->cut = co.cut;
+        stats->units = co.num_units;
+        stats->workers = co.num_workers;
+        stats->tested = co.tested;
+        stats->work = co.work;
+        stats->streamed = co.streamed;
+        stats->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    }
+
+out:
+    levels_free(&lv);
+    free(workers);
+    free(co.units);
+    free(co.todo);
+    free(co.top);
+    return ret;
+}
+
+/* ========================================================================
+ * COMMAND LINE
+ * ======================================================================== */
+
+static int usage(void)
+{
+    fprintf(stderr,
+            "Usage: resistorcal --deep PARTS TARGET [--tol T] [--part-tol T] [--limit K]\n"
+            "                   [--guaranteed] [--max-work N] [--workers N | --connect HOST:PORT,...]\n"
+            "                   VALUE...\n"
+            "       resistorcal --shard-worker [HOST:]PORT\n");
+    return 2;
+}
+
+int shard_main(int argc, char **argv)
+{
+    ShardSpec spec;
+    ShardStats stats;
+    ShardResult *results;
+    double *values;
+    int limit = 10, count, i;
+
+    if (argc == 3 && strcmp(argv[1], "--shard-worker") == 0)
+        return shard_worker_listen(argv[2]);
+    if (argc < 5 || strcmp(argv[1], "--deep") != 0)
+        return usage();
+
+    memset(&spec, 0, sizeof(spec));
+    spec.parts = atoi(argv[2]);
+    spec.target = strtod(argv[3], NULL);
+    spec.tol = 0.01;
+    spec.part_tol = 0.01;
+    spec.max_work = 1000000000L;
+    values = malloc(argc * sizeof(double));
+    if (!values)
+        return 1;
+    for (i = 4, count = 0; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--guaranteed") == 0)
+            spec.guaranteed = 1;
+        else if (arg[0] == '-' && arg[1] == '-' && i + 1 < argc) {
+            const char *val = argv[++i];
+            if (strcmp(arg, "--tol") == 0) spec.tol = strtod(val, NULL);
+            else if (strcmp(arg, "--part-tol") == 0) spec.part_tol = strtod(val, NULL);
+            else if (strcmp(arg, "--limit") == 0) limit = atoi(val);
+            else if (strcmp(arg, "--max-work") == 0) {
+                double work = strtod(val, NULL);
+                spec.max_work = work > 0 && work < 1e18 ? (long)work : 0;   /* 0 = no limit */
+            }
+            else if (strcmp(arg, "--workers") == 0) spec.workers = atoi(val);
+            else if (strcmp(arg, "--connect") == 0) spec.connect = val;
+            else {
+                free(values);
+                return usage();
+            }
+        } else {
+            values[count] = strtod(arg, NULL);
+            if (values[count] <= 0) {
+                free(values);
+                return usage();
+            }
+            count++;
+        }
+    }
+    spec.values = values;
+    spec.count = count;
+    if (limit < 1) limit = 1;
+    if (limit > MAX_TOP_K) limit = MAX_TOP_K;
+
+    results = malloc(limit * sizeof(ShardResult));
+    if (!results) {
+        free(values);
+        return 1;
+    }
+    count = shard_search(&spec, results, limit, &stats);
+    for (i = 0; i < count; i++)
+        printf("%.10g\t%.6g%%\t%d\t%s\n", results[i].R, results[i].error * 100,
+               results[i].n, results[i].expr);
+    if (count == 0)
+        fprintf(stderr, "No network of up to %d parts within %g%% of %g\n",
+                spec.parts, spec.tol * 100, spec.target);
+    if (count >= 0 && stats.cut > 0)
+        fprintf(stderr, "%d of %d units stopped at their share of --max-work %ld: these are the\n"
+                "best networks found, not necessarily the best there are\n",
+                stats.cut, stats.units, spec.max_work);
+    if (count >= 0 && !stats.complete)
+        fprintf(stderr, "Only networks of up to %d parts are held for this inventory: deeper ones\n"
+                "were searched as one of them joined with the rest, so some of more than %d\n"
+                "parts were not reached\n", stats.levels, 2 * stats.levels);
+    if (count >= 0)
+        fprintf(stderr, "%d units on %d workers: %ld networks tested, %ld lookups and tests,"
+                " %ld streamed, %.3f s\n", stats.units, stats.workers, stats.tested, stats.work,
+                stats.streamed, stats.seconds);
+    free(results);
+    free(values);
+    return count < 0 ? 1 : 0;
+}
+
+#endif /* !_WIN32 */
@@ -0,0 +1,105 @@
+/*
+ * shard.h - Sharded deep network search
+ *
+ * Networks of more than MAX_N parts are never materialized. Every
+ * network of up to `levels` parts (MAX_N, or fewer when the inventory
+ * would not fit in MAX_DEEP_NETWORKS) is built once, with no cap per
+ * level, and sorted by R. A deeper network is one of them combined with
+ * a right side that is either materialized or split the same way again,
+ * so every network of up to 2 * levels parts is reached; beyond that,
+ * splits with both sides deeper than `levels` are not. The R window the
+ * right side must fall in follows from the target and the left side,
+ * and the left sides that can reach it follow from the R range of the
+ * right side, so each split is a pair of binary searches rather than a
+ * scan of all pairs. The coordinator cuts the top-level splits into
+ * units of (level, split, left-index range) and hands them to worker
+ * processes, which stream back the candidates within tolerance. The
+ * coordinator keeps the best K, ranked by error, then part count, then
+ * network identity, so any worker count or placement returns the same
+ * list unless a unit ran out of its work budget.
+ *
+ * Workers are forked locally (talking over pipes) or reached over TCP
+ * (`resistorcal --shard-worker [HOST:]PORT`), with the same line
+ * protocol either way:
+ *
+ *   coordinator -> worker
+ *     Q levels target tol guaranteed k part_tol count value...
+ *                                       query; worker builds levels 1..levels
+ *     B error                           current K-th best error, for pruning
+ *     U id level split first last budget
+ *                                       work unit: left indexes [first, last),
+ *                                       at most budget lookups (0 = no limit)
+ *     E                                 no more units
+ *   worker -> coordinator
+ *     C R R_lo R_hi depth [op n i]... n i
+ *                                       candidate: depth combinations, outermost
+ *                                       first, each op with materialized network
+ *                                       (n, i) on the left, around network (n, i)
+ *     D id tested work cut              unit done: networks tested, lookups and
+ *                                       tests, 1 if it stopped at its budget
+ *
+ * Units of a worker that disconnects are handed to the others.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RESISTORCAL_SHARD_H
+#define RESISTORCAL_SHARD_H
+
+#include "network.h"
+
+#define MAX_DEEP_PARTS (2 * MAX_N)   /* largest network searched */
+#define MAX_DEEP_NETWORKS (1L << 21) /* materialized networks, all levels together */
+#define MAX_SHARD_WORKERS 64
+#define MAX_TOP_K 1000
+#define MAX_DEEP_EXPR (4 * MAX_EXPR)
+
+typedef struct {
+    const double *values;          /* available resistances (ohms) */
+    int count;
+    double part_tol;               /* tolerance of every part, relative */
+    int parts;                     /* networks of up to this many parts */
+    double target;                 /* target resistance (ohms) */
+    double tol;                    /* allowed error, relative */
+    int guaranteed;                /* require the worst-case interval in spec */
+    long max_work;                 /* lookups and tests over all units (0 = no limit) */
+    int workers;                   /* local processes to fork (0 = one per CPU) */
+    const char *connect;           /* or comma-separated HOST:PORT workers */
+} ShardSpec;
+
+typedef struct {
+    double R, R_lo, R_hi;
+    double error;                  /* relative error (0-1) */
+    int n;                         /* number of resistors */
+    char expr[MAX_DEEP_EXPR];      /* ends in "..." if longer */
+} ShardResult;
+
+typedef struct {
+    int levels;                    /* parts of the largest networks held */
+    int complete;                  /* every network of up to parts parts was reachable */
+    int cut;                       /* units stopped at their share of max_work */
+    int units, workers;
+    long tested;                   /* networks tested by the workers */
+    long work;                     /* their lookups and tests, as max_work counts */
+    long streamed;                 /* candidates they sent */
+    double seconds;
+} ShardStats;
+
+/*
+ * Best max_results (at most MAX_TOP_K) networks for spec, sorted, and
+ * stats of the run unless NULL. Returns the count, or -1 with a message
+ * on stderr.
+ */
+int shard_search(const ShardSpec *spec, ShardResult *results, int max_results,
+                 ShardStats *stats);
+
+/*
+ * Serve coordinators one connection at a time on [HOST:]PORT (HOST
+ * defaults to 127.0.0.1). Returns the process exit status on failure.
+ */
+int shard_worker_listen(const char *addr);
+
+/* `resistorcal --deep ...` and `resistorcal --shard-worker ...` */
+int shard_main(int argc, char **argv);
+
+#endif /* RESISTORCAL_SHARD_H */
@@ -0,0 +1,231 @@
+/*
+ * wasm.c - WebAssembly bindings for the PWA
+ *
+ * Flat, allocation-free entry points over the network and ladder engines
+ * for web/engine.js. Results are handed back in static buffers that the
+ * JS side reads straight out of the module heap, so a query costs no
+ * per-network objects on either side. Built only by the Emscripten
+ * branch of CMakeLists.txt.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "network.h"
+#include "ladder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#define WASM_EXPORT EMSCRIPTEN_KEEPALIVE
+#else
+#define WASM_EXPORT
+#endif
+
+#define RESULT_FIELDS 4   /* R, relative error, level, index */
+
+static NetworkSet networks;
+static int networks_built = 0;
+static Result *results = NULL;
+static double *packed = NULL;     /* RESULT_FIELDS doubles per result */
+
+static Ladder ladder;
+static double ladder_stats[6];
+
+/* ========================================================================
+ * NETWORK SEARCH
+ * ======================================================================== */
+
+/*
+ * Start a new network set from count values (ohms): level 1 only, the
+ * caller adds levels 2..rc_max_parts() with rc_build_level so results
+ * can be reported as levels complete. Returns the level 1 count, or -1.
+ */
+WASM_EXPORT int rc_build_begin(const double *values, int count)
+{
+    Part *parts;
+    int i;
+
+    if (networks_built) {
+        network_set_free(&networks);
+        networks_built = 0;
+    }
+    if (!results) {
+        results = malloc(MAX_NETWORKS * sizeof(Result));
+        packed = malloc(MAX_NETWORKS * RESULT_FIELDS * sizeof(double));
+        if (!results || !packed) {
+            free(results);
+            free(packed);
+            results = NULL;
+            packed = NULL;
+            return -1;
+        }
+    }
+
+    parts = malloc((count > 0 ? count : 1) * sizeof(Part));
+    if (!parts)
+        return -1;
+    for (i = 0; i < count; i++) {
+        parts[i].R = values[i];
+        parts[i].tol = 0.01;
+        parts[i].tcr = 0;
+        parts[i].power = 0;
+    }
+    if (network_set_begin(&networks, parts, count) < 0) {
+        free(parts);
+        return -1;
+    }
+    free(parts);
+    networks_built = 1;
+    return networks.count[1];
+}
+
+/*
+ * Build level n (2..MAX_N) of the current set, multi-threaded in the
+ * pthreads build. Returns its network count, or -1.
+ */
+WASM_EXPORT int rc_build_level(int n)
+{
+    if (!networks_built || n < 2 || n > MAX_N)
+        return 0;
+    if (network_set_build_level(&networks, n) != 0)
+        return -1;
+    return networks.count[n];
+}
+
+/*
+ * Networks of the levels built so far within tol of target, best
+ * first. Read them with rc_results().
+ */
+WASM_EXPORT int rc_search(double target, double tol)
+{
+    SearchSpec spec;
+    int i, count;
+
+    if (!networks_built || target <= 0)
+        return 0;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.target = target;
+    spec.tol = tol;
+    spec.op_mode = OPERATING_NONE;
+
+    count = network_collect(&networks, &spec, results, MAX_NETWORKS);
+    for (i = 0; i < count; i++) {
+        double *p = packed + (size_t)i * RESULT_FIELDS;
+        p[0] = results[i].R;
+        p[1] = results[i].error;
+        p[2] = results[i].level;
+        p[3] = results[i].index;
+    }
+    return count;
+}
+
+/* Packed results of the last rc_search: RESULT_FIELDS doubles each */
+WASM_EXPORT const double *rc_results(void)
+{
+    return packed;
+}
+
+/*
+ * Postfix form of network (n, i) into out (at least 2 * MAX_N - 1
+ * doubles): a part's value pushes it, -1 is series and -2 parallel.
+ * Returns the length.
+ */
+WASM_EXPORT int rc_compile(int n, int i, double *out)
+{
+    NetProgram prog;
+    int k, leaf = 0;
+
+    if (!networks_built || n < 1 || n > MAX_N || i < 0 || i >= networks.count[n])
+        return 0;
+
+    network_compile(&networks, n, i, &prog);
+    for (k = 0; k < prog.num_ops; k++) {
+        switch (prog.op[k]) {
+        case NET_LEAF:
+            out[k] = prog.leaf[leaf++];
+            break;
+        case NET_SERIES:
+            out[k] = -1;
+            break;
+        default:
+            out[k] = -2;
+            break;
+        }
+    }
+    return prog.num_ops;
+}
+
+/*
+ * Equivalent R of every network of level n into out (at least
+ * MAX_NETWORKS doubles), in build order. Returns the count.
+ */
+WASM_EXPORT int rc_level_values(int n, double *out)
+{
+    int i;
+
+    if (!networks_built || n < 1 || n > MAX_N)
+        return 0;
+    for (i = 0; i < networks.count[n]; i++)
+        out[i] = networks.level[n][i].R;
+    return networks.count[n];
+}
+
+WASM_EXPORT int rc_max_parts(void)
+{
+    return MAX_N;
+}
+
+/* ========================================================================
+ * R-2R LADDER
+ * ======================================================================== */
+
+/* Nominal ladder, or one drawn within tol when tol > 0 */
+WASM_EXPORT int rc_ladder_set(int bits, double R, double tol, double seed)
+{
+    if (bits < 2 || bits > MAX_R2R_BITS || R <= 0)
+        return -1;
+    if (tol > 0)
+        ladder_sample(&ladder, bits, R, tol, (unsigned long)seed);
+    else
+        ladder_init_ideal(&ladder, bits, R);
+    return 0;
+}
+
+/* Vout/Vref of count codes of the current ladder */
+WASM_EXPORT void rc_ladder_outputs(const double *codes, double *vout, int count)
+{
+    double gain[MAX_R2R_BITS];
+    int i, k;
+
+    ladder_gains(&ladder, gain, NULL);
+    for (i = 0; i < count; i++) {
+        long code = (long)codes[i];
+        double v = 0;
+        for (k = 0; k < ladder.bits; k++)
+            if (code & (1L << k))
+                v += gain[k];
+        vout[i] = v;
+    }
+}
+
+/*
+ * Full-code linearity of the current ladder: INL max/min, DNL max/min
+ * (LSB), non-monotonic codes and gain error. NULL on allocation failure.
+ */
+WASM_EXPORT const double *rc_ladder_linearity(void)
+{
+    LadderLinearity lin;
+
+    if (ladder_linearity(&ladder, &lin) < 0)
+        return NULL;
+    ladder_stats[0] = lin.inl_max;
+    ladder_stats[1] = lin.inl_min;
+    ladder_stats[2] = lin.dnl_max;
+    ladder_stats[3] = lin.dnl_min;
+    ladder_stats[4] = (double)lin.non_monotonic;
+    ladder_stats[5] = lin.gain_error;
+    return ladder_stats;
+}
@@ -0,0 +1,634 @@
+/*
+ * Resistor engine for the PWA
+ *
+ * Runs the desktop C core compiled to WebAssembly (resistorcal-core.js /
+ * .wasm, built by `emcmake cmake`) so both platforms share one engine and
+ * give identical results. Cross-origin-isolated pages (sw.js adds the
+ * COOP/COEP headers) load the pthreads build, resistorcal-core-mt, whose
+ * worker pool builds each level in parallel in a SharedArrayBuffer heap.
+ * Otherwise the single-threaded core is used, and a JavaScript port of
+ * the same enumeration when no module loads.
+ *
+ * Networks are built one level (part count) at a time so a caller can
+ * report results as levels complete, and results travel as packed typed
+ * arrays that can be transferred from a worker without copying:
+ *   R, error    Float64Array   equivalent R, relative error
+ *   n           Uint8Array     parts
+ *   program     Float64Array   PROGRAM_MAX postfix ops per result: a part
+ *                              value pushes it, -1 is series, -2 parallel
+ *   programLen  Uint8Array     ops used per result
+ * Works both on a page and inside a worker (see search-worker.js).
+ *
+ * The standard selection is also shipped precomputed (web/tables, made by
+ * scripts/generate-web-tables.sh): every network sorted by R, so a query
+ * is a binary search with no enumeration at all. Other selections are
+ * turned into the same kind of table after their first search and cached
+ * in IndexedDB.
+ */
+
+const Engine = (() => {
+  const MAX_N = 5, MAX_NET = 10000;   // same limits as src/network.h
+  const RESULT_FIELDS = 4;            // R, relative error, level, index (see src/wasm.c)
+  const PROGRAM_MAX = 16;             // postfix ops of one network
+
+  let core = null;
+  let threads = 1;
+  let loading = null;
+  let builtKey = null, builtLevel = 0;
+  let program = 0;                    // heap scratch for rc_compile
+  let levelBuf = 0;                   // heap scratch for rc_level_values
+  let codesBuf = 0, voutBuf = 0, codesCap = 0;
+
+  const TABLES = ['tables/standard.bin'];
+  const TABLE_SERIES = 254, TABLE_PARALLEL = 255;
+  const TABLE_STRIDE = 2 * MAX_N - 1;
+  const tables = new Map();           // url -> Promise of parsed table (or null)
+
+  const CACHE_DB = 'resistorcal-tables';
+  const CACHE_BUDGET = 32 << 20;      // bytes of cached tables kept in IndexedDB
+  let cacheDb = null;                 // Promise of the open database (or null)
+  let storedKey = null;
+
+  function loadScript(src) {
+    return new Promise((resolve, reject) => {
+      if (typeof importScripts === 'function') {
+        try { importScripts(src); resolve(); } catch (e) { reject(e); }
+        return;
+      }
+      const s = document.createElement('script');
+      s.src = src;
+      s.onload = resolve;
+      s.onerror = reject;
+      document.head.appendChild(s);
+    });
+  }
+
+  function loadCore(script) {
+    return loadScript(script)
+      .then(() => createResistorCore({ mainScriptUrlOrBlob: script }))
+      .then(m => {
+        core = m;
+        program = core._malloc(PROGRAM_MAX * 8);
+        levelBuf = core._malloc(MAX_NET * 8);
+        builtKey = null;
+      });
+  }
+
+  // Load the WebAssembly core once; resolves to the engine in use
+  function load() {
+    if (!loading) {
+      const cores = (self.navigator && navigator.hardwareConcurrency) || 1;
+      const shared = self.crossOriginIsolated && typeof SharedArrayBuffer === 'function';
+      const single = () => loadCore('resistorcal-core.js').then(() => { threads = 1; });
+
+      loading = (shared && cores > 1
+          ? loadCore('resistorcal-core-mt.js').then(() => { threads = cores; }, single)
+          : single())
+        .catch(() => { core = null; threads = 1; })
+        .then(() => core ? 'wasm' : 'js');
+    }
+    return loading;
+  }
+
+  const fmt = v => {
+    if (v >= 1e6) return (v/1e6).toFixed(v%1e6 ? 1 : 0) + 'M';
+    if (v >= 1e3) return (v/1e3).toFixed(v%1e3 ? 1 : 0) + 'K';
+    return String(v);
+  };
+
+  function packed(total, count) {
+    return {
+      total,
+      R: new Float64Array(count),
+      error: new Float64Array(count),
+      n: new Uint8Array(count),
+      program: new Float64Array(count * PROGRAM_MAX),
+      programLen: new Uint8Array(count)
+    };
+  }
+
+  // ===================== JavaScript Backend =====================
+
+  // levels[n]: networks of n parts; op 0 = part, 1 = series, 2 = parallel
+  let levels = [];
+
+  function makeLevel(cap) {
+    return {
+      count: 0,
+      R: new Float64Array(cap),
+      op: new Uint8Array(cap),
+      ln: new Uint8Array(cap),          // left operand level (right is n - ln)
+      li: new Int32Array(cap),
+      ri: new Int32Array(cap)
+    };
+  }
+
+  const js = {
+    begin(values) {
+      levels = [null, makeLevel(values.length)];
+      values.forEach((r, i) => { levels[1].R[i] = r; });
+      levels[1].count = values.length;
+    },
+
+    // Same order and cap as network_set_build_level() in src/network.c
+    buildLevel(n) {
+      const L = levels[n] = makeLevel(MAX_NET);
+      const push = (R, op, i, a, b) => {
+        const k = L.count++;
+        L.R[k] = R; L.op[k] = op; L.ln[k] = i; L.li[k] = a; L.ri[k] = b;
+      };
+      for (let i = 1; i < n; i++) {
+        const j = n - i, A = levels[i], B = levels[j];
+        for (let a = 0; a < A.count; a++) {
+          if (L.count >= MAX_NET) return;
+          const ra = A.R[a];
+          for (let b = i === j ? a : 0; b < B.count; b++) {
+            const rb = B.R[b];
+            if (L.count < MAX_NET) push(ra + rb, 1, i, a, b);
+            if (ra > 0 && rb > 0 && L.count < MAX_NET) push(1/(1/ra + 1/rb), 2, i, a, b);
+          }
+        }
+      }
+    },
+
+    levelValues(n) {
+      return levels[n].R.subarray(0, levels[n].count);
+    },
+
+    compile(n, i, out, off) {
+      const L = levels[n];
+      if (L.op[i] === 0) {
+        out[off] = L.R[i];
+        return 1;
+      }
+      const ln = L.ln[i];
+      let len = this.compile(ln, L.li[i], out, off);
+      len += this.compile(n - ln, L.ri[i], out, off + len);
+      out[off + len] = L.op[i] === 1 ? -1 : -2;
+      return len + 1;
+    },
+
+    collect(target, tol, limit) {
+      const lv = [], ix = [], err = [];
+      for (let n = 1; n < levels.length; n++) {
+        const L = levels[n];
+        for (let i = 0; i < L.count; i++) {
+          const e = Math.abs(L.R[i] - target) / target;
+          if (e <= tol) { lv.push(n); ix.push(i); err.push(e); }
+        }
+      }
+      const order = Array.from(err.keys()).sort((a, b) => err[a] - err[b]);
+      const count = Math.min(order.length, limit);
+      const res = packed(order.length, count);
+      for (let k = 0; k < count; k++) {
+        const m = order[k];
+        res.R[k] = levels[lv[m]].R[ix[m]];
+        res.error[k] = err[m];
+        res.n[k] = lv[m];
+        res.programLen[k] = this.compile(lv[m], ix[m], res.program, k * PROGRAM_MAX);
+      }
+      return res;
+    }
+  };
+
+  // ===================== WebAssembly Backend =====================
+
+  const wasm = {
+    begin(values) {
+      const buf = core._malloc(Math.max(1, values.length) * 8);
+      core.HEAPF64.set(values, buf / 8);
+      const count = core._rc_build_begin(buf, values.length);
+      core._free(buf);
+      if (count < 0) throw new Error('engine out of memory');
+    },
+
+    buildLevel(n) {
+      if (core._rc_build_level(n) < 0) throw new Error('engine out of memory');
+    },
+
+    levelValues(n) {
+      const count = core._rc_level_values(n, levelBuf);
+      return core.HEAPF64.slice(levelBuf / 8, levelBuf / 8 + count);
+    },
+
+    compile(n, i, out, off) {
+      const len = core._rc_compile(n, i, program);
+      out.set(core.HEAPF64.subarray(program / 8, program / 8 + len), off);
+      return len;
+    },
+
+    collect(target, tol, limit) {
+      const total = core._rc_search(target, tol);
+      const count = Math.min(total, limit);
+      const res = packed(total, count);
+      const base = core._rc_results() / 8;
+      for (let k = 0; k < count; k++) {
+        const p = base + k * RESULT_FIELDS;
+        const heap = core.HEAPF64;
+        res.R[k] = heap[p];
+        res.error[k] = heap[p + 1];
+        res.n[k] = heap[p + 2];
+        res.programLen[k] = this.compile(heap[p + 2], heap[p + 3], res.program, k * PROGRAM_MAX);
+      }
+      return res;
+    }
+  };
+
+  const backend = () => core ? wasm : js;
+
+  // ===================== Search Jobs =====================
+
+  /*
+   * Start (or resume) building the networks of a selection. The set is
+   * kept between jobs, so a repeated selection skips the levels already
+   * built. Order matters: it decides which networks the per-level cap
+   * keeps. step() builds the next level; false once all are built.
+   */
+  function begin(values) {
+    const key = Array.from(values).join(',');
+    if (key !== builtKey) {
+      backend().begin(values);
+      builtKey = key;
+      builtLevel = 1;
+    }
+    return {
+      maxParts: MAX_N,
+      get level() { return builtLevel; },
+      step() {
+        if (builtLevel >= MAX_N) return false;
+        backend().buildLevel(++builtLevel);
+        return true;
+      }
+    };
+  }
+
+  // Best limit matches within tol over the levels built so far
+  function collect(target, tol, limit) {
+    return backend().collect(target, tol, limit);
+  }
+
+  // Expression and parts of packed results from..to-1 (default all)
+  function unpack(res, from = 0, to = res.R.length) {
+    const out = [];
+    for (let k = from; k < to; k++) {
+      const stack = [];
+      const off = k * PROGRAM_MAX;
+      for (let p = off; p < off + res.programLen[k]; p++) {
+        const op = res.program[p];
+        if (op > 0) {
+          stack.push({ expr: fmt(op), parts: [op] });
+          continue;
+        }
+        const B = stack.pop(), A = stack.pop();
+        stack.push({
+          expr: op === -1 ? `(${A.expr}+${B.expr})` : `(${A.expr}∥${B.expr})`,
+          parts: A.parts.concat(B.parts)
+        });
+      }
+      out.push({ R: res.R[k], n: res.n[k], expr: stack[0].expr, parts: stack[0].parts, error: res.error[k] * 100 });
+    }
+    return out;
+  }
+
+  // Whole search in one call (no streaming)
+  function search(values, target, tol, limit = 30) {
+    const job = begin(values);
+    while (job.step());
+    const res = collect(target, tol, limit);
+    return { total: res.total, results: unpack(res), maxParts: MAX_N };
+  }
+
+  // Run one search on a given backend, rebuilding from scratch
+  function searchWith(name, values, target, tol, limit = 30) {
+    const saved = core;
+    if (name === 'js') core = null;
+    builtKey = null;
+    try {
+      return search(values, target, tol, limit);
+    } finally {
+      core = saved;
+      builtKey = null;
+    }
+  }
+
+  // ===================== Precomputed Tables =====================
+
+  // Parse a table file (layout in scripts/web-tables.c)
+  function parseTable(buf) {
+    const view = new DataView(buf);
+    if (buf.byteLength < 16 || String.fromCharCode(...new Uint8Array(buf, 0, 4)) !== 'RNT1')
+      throw new Error('bad table');
+    const numValues = view.getUint32(4, true);
+    const count = view.getUint32(8, true);
+    const stride = view.getUint32(12, true);
+    const f64 = (off, len) => {
+      const out = new Float64Array(len);
+      for (let i = 0; i < len; i++) out[i] = view.getFloat64(off + i * 8, true);
+      return out;
+    };
+    let off = 16;
+    const values = f64(off, numValues);
+    off += numValues * 8;
+    const R = f64(off, count);
+    off += count * 8;
+    const n = new Uint8Array(buf, off, count);
+    off += count;
+    const program = new Uint8Array(buf, off, count * stride);
+    return { values, R, n, program, stride, maxParts: (stride + 1) / 2 };
+  }
+
+  function loadTable(url) {
+    if (!tables.has(url)) {
+      tables.set(url, fetch(url)
+        .then(r => r.ok ? r.arrayBuffer() : Promise.reject())
+        .then(parseTable)
+        .catch(() => null));
+    }
+    return tables.get(url);
+  }
+
+  // The shipped table built from exactly this selection (sorted, as calculate() passes it), or null
+  async function findTable(values) {
+    for (const url of TABLES) {
+      const table = await loadTable(url);
+      if (table && table.values.length === values.length &&
+          table.values.every((v, i) => v === values[i]))
+        return table;
+    }
+    return null;
+  }
+
+  // Best limit matches within tol: walk outwards from target, nearest first
+  function tableSearch(table, target, tol, limit) {
+    const R = table.R, count = R.length;
+    const err = i => Math.abs(R[i] - target) / target;
+    const bound = (lo, hi, pred) => {       // first index in [lo, hi) where pred holds
+      while (lo < hi) {
+        const mid = (lo + hi) >> 1;
+        if (pred(mid)) hi = mid; else lo = mid + 1;
+      }
+      return lo;
+    };
+
+    const mid = bound(0, count, i => R[i] >= target);
+    const first = bound(0, mid, i => err(i) <= tol);
+    const end = bound(mid, count, i => err(i) > tol);
+    const total = end - first;
+    const res = packed(total, Math.min(total, limit));
+
+    let left = mid - 1, right = mid;
+    for (let k = 0; k < res.R.length; k++) {
+      let i;
+      if (left < first) i = right++;
+      else if (right >= end) i = left--;
+      else {
+        const el = err(left), er = err(right);
+        i = el < er || (el === er && table.n[left] <= table.n[right]) ? left-- : right++;
+      }
+      res.R[k] = R[i];
+      res.error[k] = err(i);
+      res.n[k] = table.n[i];
+      const len = 2 * table.n[i] - 1;
+      res.programLen[k] = len;
+      for (let p = 0; p < len; p++) {
+        const code = table.program[i * table.stride + p];
+        res.program[k * PROGRAM_MAX + p] = code === TABLE_SERIES ? -1
+          : code === TABLE_PARALLEL ? -2 : table.values[code];
+      }
+    }
+    return res;
+  }
+
+  // ===================== Table Cache =====================
+
+  /*
+   * Custom selections get the same treatment as the shipped ones once
+   * they have been searched: the built levels are sorted into a table and
+   * kept in IndexedDB, keyed by a hash of the selection, so the next
+   * search of that selection (also after a reload) is a tableSearch().
+   * Least recently used tables are dropped past CACHE_BUDGET, and all of
+   * them when CACHE_NAME (version.js, shared with sw.js) changes. Pages
+   * that do not load version.js (bench.html) run without the cache.
+   */
+
+  const request = req => new Promise((resolve, reject) => {
+    req.onsuccess = () => resolve(req.result);
+    req.onerror = () => reject(req.error);
+  });
+
+  const complete = tx => new Promise((resolve, reject) => {
+    tx.oncomplete = resolve;
+    tx.onerror = tx.onabort = () => reject(tx.error);
+  });
+
+  function openCache() {
+    if (!cacheDb) {
+      cacheDb = (async () => {
+        if (typeof CACHE_NAME === 'undefined' || !self.indexedDB) return null;
+        const open = indexedDB.open(CACHE_DB, 1);
+        open.onupgradeneeded = () => {
+          const db = open.result;
+          db.createObjectStore('tables');
+          db.createObjectStore('lru').createIndex('used', 'used');
+          db.createObjectStore('meta');
+        };
+        const db = await request(open);
+        const tx = db.transaction(['tables', 'lru', 'meta'], 'readwrite');
+        if (await request(tx.objectStore('meta').get('version')) !== CACHE_NAME) {
+          tx.objectStore('tables').clear();
+          tx.objectStore('lru').clear();
+          tx.objectStore('meta').put(CACHE_NAME, 'version');
+        }
+        await complete(tx);
+        return db;
+      })().catch(() => null);
+    }
+    return cacheDb;
+  }
+
+  // FNV-1a over the sorted selection's bytes; tables keep their values to rule out collisions
+  function selectionKey(values) {
+    let h = 0x811c9dc5;
+    for (const b of new Uint8Array(Float64Array.from(values).buffer))
+      h = Math.imul(h ^ b, 0x01000193);
+    return `${values.length}:${(h >>> 0).toString(16)}`;
+  }
+
+  const sameValues = (a, b) => a.length === b.length && a.every((v, i) => v === b[i]);
+  const tableBytes = t => t.values.byteLength + t.R.byteLength + t.n.byteLength + t.program.byteLength;
+
+  // The cached table of exactly this selection, or null
+  async function cachedTable(values) {
+    try {
+      const db = await openCache();
+      if (!db) return null;
+      const key = selectionKey(values);
+      const tx = db.transaction(['tables', 'lru'], 'readwrite');
+      let table = await request(tx.objectStore('tables').get(key));
+      if (table && sameValues(table.values, values))
+        tx.objectStore('lru').put({ used: Date.now(), bytes: tableBytes(table) }, key);
+      else
+        table = null;
+      await complete(tx);
+      return table;
+    } catch (e) {
+      return null;
+    }
+  }
+
+  // Store a table, then evict least recently used ones past the budget
+  async function storeTable(table) {
+    const db = await openCache();
+    if (!db) return;
+    const key = selectionKey(table.values);
+    const tx = db.transaction(['tables', 'lru'], 'readwrite');
+    const lru = tx.objectStore('lru');
+    tx.objectStore('tables').put(table, key);
+    lru.put({ used: Date.now(), bytes: tableBytes(table) }, key);
+
+    let bytes = 0;
+    const cursor = lru.index('used').openCursor(null, 'prev');
+    cursor.onsuccess = () => {
+      const c = cursor.result;
+      if (!c) return;
+      bytes += c.value.bytes;
+      if (bytes > CACHE_BUDGET) {
+        tx.objectStore('tables').delete(c.primaryKey);
+        c.delete();
+      }
+      c.continue();
+    };
+    await complete(tx);
+  }
+
+  /*
+   * Table of the set built from values (all levels), in the layout of
+   * the shipped ones: sorted by R, then parts, then build order. Null if
+   * the selection has too many values for the one-byte program codes.
+   */
+  function exportTable(values) {
+    if (values.length >= TABLE_SERIES) return null;
+    const b = backend();
+    const index = new Map();
+    values.forEach((v, i) => { if (!index.has(v)) index.set(v, i); });
+
+    const R = [], lv = [], ix = [];
+    for (let n = 1; n <= MAX_N; n++) {
+      const level = b.levelValues(n);
+      for (let i = 0; i < level.length; i++) { R.push(level[i]); lv.push(n); ix.push(i); }
+    }
+    const order = Array.from(R.keys()).sort((x, y) => R[x] - R[y] || lv[x] - lv[y] || x - y);
+
+    const count = order.length;
+    const table = {
+      values: Float64Array.from(values),
+      R: new Float64Array(count),
+      n: new Uint8Array(count),
+      program: new Uint8Array(count * TABLE_STRIDE),
+      stride: TABLE_STRIDE,
+      maxParts: MAX_N
+    };
+    const ops = new Float64Array(PROGRAM_MAX);
+    order.forEach((m, k) => {
+      table.R[k] = R[m];
+      table.n[k] = lv[m];
+      const len = b.compile(lv[m], ix[m], ops, 0);
+      for (let p = 0; p < len; p++)
+        table.program[k * TABLE_STRIDE + p] = ops[p] === -1 ? TABLE_SERIES
+          : ops[p] === -2 ? TABLE_PARALLEL : index.get(ops[p]);
+    });
+    return table;
+  }
+
+  // ===================== Streaming Search =====================
+
+  // Let queued messages and events run, so a newer search can supersede this one
+  const tick = () => new Promise(r => setTimeout(r, 0));
+
+  /*
+   * Search values for target, reporting packed results plus { level,
+   * maxParts, done, engine, threads } through onResult after every level,
+   * or once when a shipped or cached table answers it. Stops at the next
+   * level boundary once isCurrent() turns false. A completed build is
+   * added to the table cache.
+   */
+  async function run(values, target, tol, limit, onResult, isCurrent = () => true) {
+    const shipped = await findTable(values);
+    const table = shipped || await cachedTable(values);
+    if (!isCurrent()) return;
+    if (table) {
+      onResult({ level: table.maxParts, maxParts: table.maxParts, done: true,
+                 engine: shipped ? 'table' : 'cache', threads: 1,
+                 ...tableSearch(table, target, tol, limit) });
+      return;
+    }
+
+    await load();
+    if (!isCurrent()) return;
+
+    const job = begin(values);
+    for (;;) {
+      const done = job.level >= job.maxParts;
+      onResult({ level: job.level, maxParts: job.maxParts, done, engine: core ? 'wasm' : 'js',
+                 threads, ...collect(target, tol, limit) });
+      if (done) break;
+
+      await tick();
+      if (!isCurrent()) return;
+      job.step();
+    }
+
+    if (builtKey !== storedKey) {
+      storedKey = builtKey;
+      const built = exportTable(values);
+      if (built) storeTable(built).catch(() => { storedKey = null; });
+    }
+  }
+
+  // ===================== R-2R Ladder =====================
+
+  // Vout/Vref per code and, with the core loaded, full-code linearity
+  function ladder(bits, R, tol, seed, codes) {
+    if (!core) {
+      const vout = Float64Array.from(codes, c => c / Math.pow(2, bits));
+      return { vout, linearity: null };
+    }
+
+    if (core._rc_ladder_set(bits, R, tol, seed) < 0) throw new Error('bad ladder');
+    if (codes.length > codesCap) {
+      if (codesCap) { core._free(codesBuf); core._free(voutBuf); }
+      codesCap = codes.length;
+      codesBuf = core._malloc(codesCap * 8);
+      voutBuf = core._malloc(codesCap * 8);
+    }
+    core.HEAPF64.set(codes, codesBuf / 8);
+    core._rc_ladder_outputs(codesBuf, voutBuf, codes.length);
+    const vout = core.HEAPF64.slice(voutBuf / 8, voutBuf / 8 + codes.length);
+
+    const stats = core._rc_ladder_linearity();
+    let linearity = null;
+    if (stats) {
+      const s = core.HEAPF64.subarray(stats / 8, stats / 8 + 6);
+      linearity = {
+        inlMax: s[0], inlMin: s[1], dnlMax: s[2], dnlMin: s[3],
+        nonMonotonic: s[4], gainError: s[5]
+      };
+    }
+    return { vout, linearity };
+  }
+
+  return {
+    load,
+    get name() { return core ? 'wasm' : 'js'; },
+    get threads() { return threads; },
+    begin,
+    collect,
+    findTable,
+    tableSearch,
+    run,
+    unpack,
+    search,
+    searchWith,
+    ladder
+  };
+})();
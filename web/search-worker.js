@@ -0,0 +1,31 @@
+/*
+ * Network search worker for the PWA
+ *
+ * Runs Engine searches off the main thread. The standard selection, and
+ * any selection searched before (IndexedDB table cache), is answered from
+ * its table in one message. Otherwise results are posted after every
+ * level (part count) is built, as transferable typed arrays, so the best
+ * small networks show up immediately. A newer message supersedes the
+ * running search at the next level boundary.
+ *
+ * Messages in:  { type: 'search', id, values: Float64Array, target, tol, limit }
+ *               { type: 'cancel', id }
+ * Messages out: { id, level, maxParts, done, engine, threads, total, R,
+ *                 error, n, program, programLen }  (see engine.js)
+ */
+
+importScripts('version.js', 'engine.js');
+
+let latest = 0;
+
+const post = (msg) => self.postMessage(msg,
+  [msg.R.buffer, msg.error.buffer, msg.n.buffer, msg.program.buffer, msg.programLen.buffer]);
+
+self.onmessage = (e) => {
+  const msg = e.data;
+  latest = msg.id;
+  if (msg.type === 'search') {
+    Engine.run(msg.values, msg.target, msg.tol, msg.limit,
+               res => post({ id: msg.id, ...res }), () => msg.id === latest);
+  }
+};
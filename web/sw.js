@@ -3,21 +3,53 @@
  * Provides offline support via cache-first strategy
  */
 
-const CACHE_NAME = 'resistorcal-v1';
+importScripts('version.js');     // CACHE_NAME
+
 const ASSETS = [
   '/',
   '/index.html',
+  '/version.js',
+  '/engine.js',
+  '/search-worker.js',
+  '/tables/standard.bin',
   '/manifest.json',
   '/icons/resistorcal.svg',
   '/icons/resistorcal-192.png',
   '/icons/resistorcal-512.png'
 ];
 
+// WebAssembly core: only present when built, so a miss must not fail install
+const OPTIONAL_ASSETS = [
+  '/resistorcal-core.js',
+  '/resistorcal-core.wasm',
+  '/resistorcal-core-mt.js',
+  '/resistorcal-core-mt.wasm'
+];
+
+/*
+ * Serve same-origin responses with COOP/COEP so pages are cross-origin
+ * isolated: SharedArrayBuffer, and with it the multi-threaded core,
+ * becomes available. Pages loaded before this worker took control run
+ * single-threaded until the next load.
+ */
+function isolate(response) {
+  if (!response || response.type === 'opaque' || response.status === 0) return response;
+  const headers = new Headers(response.headers);
+  headers.set('Cross-Origin-Opener-Policy', 'same-origin');
+  headers.set('Cross-Origin-Embedder-Policy', 'require-corp');
+  return new Response(response.body, {
+    status: response.status,
+    statusText: response.statusText,
+    headers
+  });
+}
+
 // Install: cache core assets
 self.addEventListener('install', (event) => {
   event.waitUntil(
     caches.open(CACHE_NAME)
-      .then((cache) => cache.addAll(ASSETS))
+      .then((cache) => cache.addAll(ASSETS).then(() =>
+        Promise.all(OPTIONAL_ASSETS.map((url) => cache.add(url).catch(() => {})))))
       .then(() => self.skipWaiting())
   );
 });
@@ -46,6 +78,7 @@ self.addEventListener('fetch', (event) => {
 
   event.respondWith(
     caches.match(event.request).then((cached) => {
+      if (url.origin !== self.location.origin) return cached || fetch(event.request);
       if (cached) {
         // Return cached, but update in background
         fetch(event.request).then((response) => {
@@ -55,7 +88,7 @@ self.addEventListener('fetch', (event) => {
             });
           }
         }).catch(() => {});
-        return cached;
+        return isolate(cached);
       }
       
       // Not cached, fetch from network
@@ -66,11 +99,11 @@ self.addEventListener('fetch', (event) => {
             cache.put(event.request, clone);
           });
         }
-        return response;
+        return isolate(response);
       }).catch(() => {
         // Offline fallback for HTML pages
         if (event.request.headers.get('accept').includes('text/html')) {
-          return caches.match('/index.html');
+          return caches.match('/index.html').then(isolate);
         }
       });
     })
@@ -0,0 +1,7 @@
+/*
+ * App version, shared by sw.js and engine.js. Bumping it replaces the
+ * service worker's asset cache and drops the network tables cached in
+ * IndexedDB, so change it whenever the engine or its assets change.
+ */
+
+const CACHE_NAME = 'resistorcal-v7';